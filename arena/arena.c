@@ -0,0 +1,56 @@
+#include "arena.h"
+
+#define ARENA_ALIGNMENT sizeof(void *)  // every allocation is pointer aligned
+
+static arena_block *new_block(size_t size) {
+    arena_block *block = (arena_block *)malloc(sizeof(arena_block) + size);
+    if (block == NULL) {
+        fprintf(stderr, "ERROR: Out of memory.\n");
+        exit(1);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(arena *a, size_t blockSize) {
+    a->head = NULL;
+    a->blockSize = blockSize;
+    a->bytesAllocated = 0;
+    a->blockCount = 0;
+}
+
+void *arena_alloc(arena *a, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);  // round up to keep alignment
+
+    if (a->head == NULL || a->head->used + size > a->head->size) {
+        size_t blockSize = size > a->blockSize ? size : a->blockSize;  // oversized requests get their own block
+        arena_block *block = new_block(blockSize);
+        block->next = a->head;
+        a->head = block;
+        a->blockCount++;
+    }
+
+    void *memory = a->head->data + a->head->used;  // bump the pointer
+    a->head->used += size;
+    a->bytesAllocated += size;
+    return memory;
+}
+
+char *arena_strndup(arena *a, const char *text, size_t length) {
+    char *copy = (char *)arena_alloc(a, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_destroy(arena *a) {
+    arena_block *block = a->head;
+    while (block != NULL) {  // free the whole chain in one sweep
+        arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(a, a->blockSize);
+}
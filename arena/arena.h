@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct arena_block_tag {
+    struct arena_block_tag *next;  // previously filled block
+    size_t size;                   // usable bytes in this block
+    size_t used;                   // bytes already handed out
+    char data[];                   // storage
+} arena_block;
+
+typedef struct arena_tag {
+    arena_block *head;       // block currently being filled
+    size_t blockSize;        // default size of a new block
+    size_t bytesAllocated;   // total bytes handed out
+    size_t blockCount;       // number of blocks requested from malloc
+} arena;
+
+void arena_init(arena *a, size_t blockSize);  // prepare an empty arena
+void *arena_alloc(arena *a, size_t size);  // bump-allocate size bytes (pointer aligned)
+char *arena_strndup(arena *a, const char *text, size_t length);  // copy a string into the arena
+void arena_destroy(arena *a);  // release every block at once
+
+#endif
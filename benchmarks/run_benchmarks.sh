@@ -0,0 +1,111 @@
+#!/bin/sh
+# Compiler throughput benchmark.
+#
+#   benchmarks/run_benchmarks.sh                    build, run every workload, compare with the baseline
+#   benchmarks/run_benchmarks.sh --update-baseline  run and store the results as the new baseline
+#
+# MYPARSER=path skips the build, REPEAT (default 5) runs each workload that many times and keeps the
+# fastest run, TOLERANCE (default 15) is the percentage of lines per second a workload may lose before
+# the comparison fails. Results go to benchmarks/results.csv and benchmarks/results.json.
+
+set -e
+cd "$(dirname "$0")/.."
+BENCH=benchmarks
+WORK=$BENCH/work
+REPEAT=${REPEAT:-5}
+TOLERANCE=${TOLERANCE:-15}
+UPDATE=0
+for arg in "$@"; do
+    case $arg in
+        --update-baseline) UPDATE=1 ;;
+        *) echo "Usage: $0 [--update-baseline]" >&2; exit 2 ;;
+    esac
+done
+
+mkdir -p $WORK
+gcc -O2 -o $WORK/workload_gen $BENCH/workload_gen.c
+if [ -z "$MYPARSER" ]; then
+    flex lexc.l
+    bison -d sydc.y
+    gcc -O2 -o $WORK/myparser sydc.tab.c lex.yy.c $(ls */*.c | grep -v "^$BENCH/") zyywrap.c -lpthread
+    MYPARSER=$WORK/myparser
+fi
+MYPARSER=$(cd "$(dirname "$MYPARSER")" && pwd)/$(basename "$MYPARSER")
+
+# name statements depth variables nesting branches
+WORKLOADS="
+small 100 3 8 2 20
+medium 2000 4 32 3 20
+large 20000 4 64 3 20
+huge 100000 4 64 3 20
+deep_expressions 500 12 16 1 10
+branchy 5000 3 32 2 60
+loops 5000 3 32 6 10
+many_variables 10000 2 1500 1 10
+"
+
+field() {  # number stored under a key of the one-line stats.json
+    sed -n "s/.*\"$1\": \([0-9]*\).*/\1/p" "$2"
+}
+
+HEADER="workload,statements,depth,variables,nesting,branches,lines,tokens,nodes,instructions,memory_words,lex_ms,parse_ms,print_tree_ms,interpret_ms,fold_ms,codegen_ms,total_ms,lines_per_second,peak_rss_kb"
+echo "$HEADER" > $BENCH/results.csv
+echo "$WORKLOADS" | while read name statements depth variables nesting branches; do
+    [ -n "$name" ] || continue
+    $WORK/workload_gen --statements=$statements --depth=$depth --variables=$variables --nesting=$nesting --branches=$branches > $WORK/$name.txt
+    lines=$(wc -l < $WORK/$name.txt)
+
+    best=""
+    run=0
+    while [ $run -lt $REPEAT ]; do
+        (cd $WORK && "$MYPARSER" --stats=json --trace=0 < $name.txt > /dev/null 2> $name.err) || true
+        total=$(awk -F'"phases_ns": {|}, "counters"' '{ n = split($2, p, ", "); t = 0; for (i = 1; i <= n; i++) { sub(/.*: /, "", p[i]); t += p[i] } printf "%.0f\n", t }' $WORK/stats.json)
+        if [ -z "$best" ] || [ "$total" -lt "$best" ]; then
+            best=$total
+            cp $WORK/stats.json $WORK/$name.stats.json
+        fi
+        run=$((run + 1))
+    done
+
+    s=$WORK/$name.stats.json
+    awk -v name=$name -v config="$statements,$depth,$variables,$nesting,$branches" -v lines=$lines -v total=$best \
+        -v tokens=$(field tokens $s) -v nodes=$(field nodes $s) -v instructions=$(field instructions_written $s) \
+        -v words=$(field memory_words $s) -v lex=$(field lex $s) -v parse=$(field parse $s) -v tree=$(field print_tree $s) \
+        -v interpret=$(field interpret $s) -v fold=$(field fold $s) -v codegen=$(field codegen $s) -v peak=$(field peak_rss_kb $s) \
+        'BEGIN { printf "%s,%s,%d,%s,%s,%s,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f,%s\n", name, config, lines, tokens, nodes,
+                 instructions, words, lex / 1e6, parse / 1e6, tree / 1e6, interpret / 1e6, fold / 1e6, codegen / 1e6, total / 1e6,
+                 lines / (total / 1e9), peak }' >> $BENCH/results.csv
+done
+
+# the same rows as a JSON array, numbers unquoted
+awk -F, 'NR == 1 { for (i = 1; i <= NF; i++) key[i] = $i; next }
+         { printf "%s  {", NR == 2 ? "[\n" : ",\n"
+           for (i = 1; i <= NF; i++) printf "%s\"%s\": %s", (i > 1 ? ", " : ""), key[i], (i == 1 ? "\"" $i "\"" : $i)
+           printf "}" }
+         END { print "\n]" }' $BENCH/results.csv > $BENCH/results.json
+column -s, -t < $BENCH/results.csv 2>/dev/null || cat $BENCH/results.csv
+
+if [ $UPDATE -eq 1 ]; then
+    cp $BENCH/results.csv $BENCH/baseline.csv
+    cp $BENCH/results.json $BENCH/baseline.json
+    echo "Baseline updated."
+    exit 0
+fi
+if [ ! -f $BENCH/baseline.csv ]; then
+    echo "No baseline yet, run with --update-baseline to record one."
+    exit 0
+fi
+
+# lines per second may drop by TOLERANCE percent; the workloads themselves must not change
+awk -F, -v tolerance=$TOLERANCE '
+    FNR == 1 { next }
+    NR == FNR { baseline[$1] = $19; baseLines[$1] = $7 "," $8; next }
+    !($1 in baseline) { printf "%-18s new workload\n", $1; next }
+    {
+        ratio = $19 / baseline[$1]
+        status = ratio < 1 - tolerance / 100 ? "REGRESSION" : "ok"
+        if (baseLines[$1] != $7 "," $8) status = status ", different source or tokens"
+        if (status != "ok") failed = 1
+        printf "%-18s %9.0f lines/s  baseline %9.0f  %+6.1f%%  %s\n", $1, $19, baseline[$1], (ratio - 1) * 100, status
+    }
+    END { exit failed }' $BENCH/baseline.csv $BENCH/results.csv
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes a random program in the compiler's language to standard output. The same options always give the
+// same program, so benchmark results stay comparable between builds and machines.
+//
+// Every program terminates and stays well inside a MIX word: variables start as constants below 100, every
+// assignment divides its expression by the most it can grow, repeat loops count a counter variable up to 2
+// or 3, and divisors are non-zero constants.
+
+#define VALUE_LIMIT 99           // largest constant and, after the scaling, largest variable value
+#define GAIN_LIMIT (1 << 20)     // no expression grows past this many times VALUE_LIMIT, far below a MIX word
+#define LOOP_PERCENT 8           // statements that open a repeat loop while the nesting allows it
+#define WRITE_PERCENT 5          // statements that print a variable
+#define BLOCK_STATEMENTS 8       // most statements directly inside one then, else or loop body
+#define BLOCK_NESTING 8          // deepest if and repeat nesting together; blocks hold more than one block on average
+
+typedef struct {
+    int statements;    // statements to generate, counting those nested in if and repeat
+    int depth;         // deepest expression tree
+    int variables;     // distinct variables besides the loop counters
+    int nesting;       // deepest repeat loop nesting
+    int branches;      // percent of statements that are if statements, half of them with an else
+    unsigned long long seed;
+} workload_options;
+
+typedef struct {
+    workload_options options;
+    unsigned long long state;  // xorshift64, the same sequence everywhere
+    int remaining;             // statements not generated yet
+    FILE *out;
+} generator;
+
+static unsigned long long next_random(generator *gen) {
+    gen->state ^= gen->state << 13;
+    gen->state ^= gen->state >> 7;
+    gen->state ^= gen->state << 17;
+    return gen->state;
+}
+
+static int random_below(generator *gen, int bound) {
+    return (int)(next_random(gen) % (unsigned long long)bound);
+}
+
+static int chance(generator *gen, int percent) {
+    return random_below(gen, 100) < percent;
+}
+
+static void indent(generator *gen, int level) {
+    for (int i = 0; i < level; i++) fputs("    ", gen->out);
+}
+
+// writes an expression no deeper than depth that may reach at most budget times VALUE_LIMIT; returns that factor
+static long long write_expression(generator *gen, int depth, long long budget) {
+    int kind = random_below(gen, 10);
+    if (depth <= 1 || budget < 2 || chance(gen, 25)) {
+        if (chance(gen, 70)) {
+            fprintf(gen->out, "v%d", random_below(gen, gen->options.variables));
+        } else {
+            fprintf(gen->out, "%d", random_below(gen, VALUE_LIMIT + 1));
+        }
+        return 1;
+    }
+
+    fputc('(', gen->out);
+    long long gain;
+    if (kind < 2) {  // scale by a small constant
+        int factor = 2 + random_below(gen, 8);
+        if (factor > budget) factor = (int)budget;
+        gain = write_expression(gen, depth - 1, budget / factor) * factor;
+        fprintf(gen->out, " * %d", factor);
+    } else if (kind < 3) {
+        gain = write_expression(gen, depth - 1, budget);
+        fprintf(gen->out, " / %d", 2 + random_below(gen, 8));
+    } else {
+        gain = write_expression(gen, depth - 1, budget / 2);
+        fputs(kind < 7 ? " + " : " - ", gen->out);
+        gain += write_expression(gen, depth - 1, budget / 2);
+    }
+    fputc(')', gen->out);
+    return gain;
+}
+
+static void write_assignment(generator *gen, int level) {
+    indent(gen, level);
+    fprintf(gen->out, "v%d := ", random_below(gen, gen->options.variables));
+
+    // write into a buffer first: the divisor depends on the expression
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = gen->out;
+    gen->out = open_memstream(&text, &length);
+    long long gain = write_expression(gen, 1 + random_below(gen, gen->options.depth), GAIN_LIMIT);
+    fclose(gen->out);
+    gen->out = out;
+
+    if (gain > 1) {
+        fprintf(gen->out, "%s / %lld", text, gain);  // back to at most VALUE_LIMIT; text is parenthesized
+    } else {
+        fputs(text, gen->out);
+    }
+    free(text);
+}
+
+static void write_condition(generator *gen) {
+    int depth = gen->options.depth < 3 ? gen->options.depth : 3;
+    write_expression(gen, 1 + random_below(gen, depth), GAIN_LIMIT);
+    fputs(chance(gen, 70) ? " < " : " = ", gen->out);
+    write_expression(gen, 1 + random_below(gen, depth), GAIN_LIMIT);
+}
+
+static void write_block(generator *gen, int level, int loops, int count);
+
+static void write_statement(generator *gen, int level, int loops) {
+    gen->remaining--;
+    int roomForBlock = gen->remaining >= 2 && level < BLOCK_NESTING;
+
+    if (roomForBlock && loops < gen->options.nesting && chance(gen, LOOP_PERCENT)) {
+        int counter = loops + 1;  // one counter per nesting level, i1 outermost
+        indent(gen, level);
+        fprintf(gen->out, "i%d := 0;\n", counter);
+        indent(gen, level);
+        fprintf(gen->out, "repeat\n");
+        write_block(gen, level + 1, counter, 1 + random_below(gen, BLOCK_STATEMENTS));
+        fprintf(gen->out, ";\n");
+        indent(gen, level + 1);
+        fprintf(gen->out, "i%d := i%d + 1\n", counter, counter);
+        indent(gen, level);
+        fprintf(gen->out, "until i%d = %d", counter, 2 + random_below(gen, 2));
+    } else if (roomForBlock && chance(gen, gen->options.branches)) {
+        indent(gen, level);
+        fprintf(gen->out, "if ");
+        write_condition(gen);
+        fprintf(gen->out, " then\n");
+        write_block(gen, level + 1, loops, 1 + random_below(gen, BLOCK_STATEMENTS));
+        if (gen->remaining > 0 && chance(gen, 50)) {
+            fprintf(gen->out, "\n");
+            indent(gen, level);
+            fprintf(gen->out, "else\n");
+            write_block(gen, level + 1, loops, 1 + random_below(gen, BLOCK_STATEMENTS));
+        }
+        fprintf(gen->out, "\n");
+        indent(gen, level);
+        fprintf(gen->out, "end");
+    } else if (chance(gen, WRITE_PERCENT)) {
+        indent(gen, level);
+        fprintf(gen->out, "write v%d", random_below(gen, gen->options.variables));
+    } else {
+        write_assignment(gen, level);
+    }
+}
+
+// count statements separated by semicolons, fewer when the budget runs out; at least one
+static void write_block(generator *gen, int level, int loops, int count) {
+    if (count > gen->remaining) count = gen->remaining;
+    if (count < 1) count = 1;
+    for (int i = 0; i < count; i++) {
+        if (i > 0) fprintf(gen->out, ";\n");
+        write_statement(gen, level, loops);
+    }
+}
+
+static int parse_option(const char *arg, const char *name, int *value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') return 0;
+    *value = atoi(arg + length + 1);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    workload_options options = {1000, 4, 16, 2, 20, 1};
+    for (int i = 1; i < argc; i++) {
+        int seed;
+        if (parse_option(argv[i], "--statements", &options.statements) ||
+            parse_option(argv[i], "--depth", &options.depth) ||
+            parse_option(argv[i], "--variables", &options.variables) ||
+            parse_option(argv[i], "--nesting", &options.nesting) ||
+            parse_option(argv[i], "--branches", &options.branches)) {
+            continue;
+        }
+        if (parse_option(argv[i], "--seed", &seed)) {
+            options.seed = (unsigned long long)seed;
+            continue;
+        }
+        fprintf(stderr, "Usage: %s [--statements=N] [--depth=N] [--variables=N] [--nesting=N] [--branches=PERCENT] [--seed=N]\n", argv[0]);
+        return 1;
+    }
+    if (options.statements < 1 || options.depth < 1 || options.variables < 1 || options.nesting < 0 ||
+        options.branches < 0 || options.branches > 100) {
+        fprintf(stderr, "Error: statements, depth and variables must be positive, branches a percentage.\n");
+        return 1;
+    }
+
+    generator gen;
+    gen.options = options;
+    gen.state = options.seed * 0x9e3779b97f4a7c15ULL + 1;  // never zero, which xorshift cannot leave
+    gen.remaining = options.statements;
+    gen.out = stdout;
+
+    for (int i = 0; i < options.variables; i++) {  // every variable holds a value before it is read
+        printf("v%d := %d;\n", i, random_below(&gen, VALUE_LIMIT + 1));
+    }
+    while (gen.remaining > 0) {
+        write_statement(&gen, 0, 0);
+        printf(";\n");
+    }
+    for (int i = 0; i < options.variables && i < 8; i++) {  // make the results visible
+        printf("write v%d%s\n", i, i + 1 < options.variables && i < 7 ? ";" : "");
+    }
+    return 0;
+}
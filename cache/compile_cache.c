@@ -0,0 +1,239 @@
+#include "compile_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define CACHE_MAGIC "MIXCACHE3\n"         // first bytes of every entry file
+#define CACHE_STALE_TEMP_SECONDS 600      // temporaries this old were left by a compile that died
+#define CACHE_BUILD __DATE__ " " __TIME__ // a rebuilt compiler does not trust older entries
+
+typedef struct {
+    char *path;
+    long long size;
+    long long used;  // modification time in nanoseconds, refreshed on every hit
+} cache_file;
+
+static void append_blob(cache_blob *blob, const void *data, size_t length) {
+    blob->data = (char *)realloc(blob->data, blob->length + length + 1);
+    memcpy(blob->data + blob->length, data, length);
+    blob->length += length;
+}
+
+int cache_read_stream(FILE *file, cache_blob *blob) {
+    size_t capacity = 64 * 1024;
+    blob->data = (char *)malloc(capacity);
+    blob->length = 0;
+    size_t got;
+    while ((got = fread(blob->data + blob->length, 1, capacity - blob->length, file)) > 0) {
+        blob->length += got;
+        if (blob->length == capacity) {
+            capacity *= 2;
+            blob->data = (char *)realloc(blob->data, capacity);
+        }
+    }
+    return ferror(file) ? -1 : 0;
+}
+
+int cache_read_file(const char *path, cache_blob *blob) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        blob->data = NULL;
+        blob->length = 0;
+        return -1;
+    }
+    int result = cache_read_stream(file, blob);
+    fclose(file);
+    return result;
+}
+
+void cache_key(const compiler_options *options, const cache_blob *source, cache_blob *key) {
+    char header[256];
+    int length = snprintf(header, sizeof(header), "mixal-compiler %s\nsimulate=%d trace=%d input=%d cfg=%d peval=%lld profile=%d emit=%d listing=%d\n",
+                          CACHE_BUILD, options->simulate, options->traceLevel, options->simulationInput != NULL, options->printCfg,
+                          options->partialEvalSteps, options->profile, options->emitFormat, options->listing);
+    key->data = NULL;
+    key->length = 0;
+    append_blob(key, header, length);
+
+    if (options->simulationInput != NULL) {  // the simulation report depends on the records it reads
+        cache_blob records;
+        cache_read_file(options->simulationInput, &records);
+        char size[32];
+        append_blob(key, size, snprintf(size, sizeof(size), "%zu\n", records.length));
+        if (records.length > 0) append_blob(key, records.data, records.length);
+        free(records.data);
+    }
+    append_blob(key, source->data, source->length);
+}
+
+static uint64_t hash_key(const cache_blob *key) {
+    uint64_t hash = 14695981039346656037ULL;  // 64-bit FNV-1a offset basis
+    for (size_t i = 0; i < key->length; i++) {
+        hash ^= (unsigned char)key->data[i];
+        hash *= 1099511628211ULL;  // 64-bit FNV-1a prime
+    }
+    return hash;
+}
+
+static char *entry_path(const char *directory, const cache_blob *key) {
+    size_t length = strlen(directory) + 32;
+    char *path = (char *)malloc(length);
+    snprintf(path, length, "%s/%016llx.entry", directory, (unsigned long long)hash_key(key));
+    return path;
+}
+
+static int write_section(FILE *file, const cache_blob *blob) {
+    uint64_t length = blob->length;
+    if (fwrite(&length, sizeof(length), 1, file) != 1) return -1;
+    if (length > 0 && fwrite(blob->data, 1, blob->length, file) != blob->length) return -1;
+    return 0;
+}
+
+static int read_section(FILE *file, cache_blob *blob) {
+    uint64_t length;
+    blob->data = NULL;
+    blob->length = 0;
+    if (fread(&length, sizeof(length), 1, file) != 1 || length > (uint64_t)SIZE_MAX - 1) return -1;
+    blob->data = (char *)malloc(length + 1);
+    blob->length = length;
+    return fread(blob->data, 1, length, file) == length ? 0 : -1;
+}
+
+int cache_lookup(const char *directory, const cache_blob *key, cache_entry *entry) {
+    memset(entry, 0, sizeof(*entry));
+    char *path = entry_path(directory, key);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        free(path);
+        return 0;
+    }
+
+    char magic[sizeof(CACHE_MAGIC) - 1];
+    cache_blob storedKey = {NULL, 0};
+    int hit = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0;
+    hit = hit && read_section(file, &storedKey) == 0;
+    hit = hit && storedKey.length == key->length && memcmp(storedKey.data, key->data, key->length) == 0;  // a hash collision is a miss
+    free(storedKey.data);
+    hit = hit && read_section(file, &entry->log) == 0 && read_section(file, &entry->mixal) == 0 &&
+          read_section(file, &entry->lines) == 0 && read_section(file, &entry->image) == 0 &&
+          read_section(file, &entry->output) == 0;
+    fclose(file);
+
+    if (hit) {
+        utime(path, NULL);  // mark it as recently used for eviction
+    } else {
+        cache_entry_free(entry);
+    }
+    free(path);
+    return hit;
+}
+
+static int compare_used(const void *a, const void *b) {
+    const cache_file *left = (const cache_file *)a;
+    const cache_file *right = (const cache_file *)b;
+    return (left->used > right->used) - (left->used < right->used);
+}
+
+// drop the least recently used entries until the directory fits in maxBytes
+static void evict(const char *directory, long long maxBytes) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) return;
+
+    cache_file *files = NULL;
+    int count = 0;
+    int capacity = 0;
+    long long total = 0;
+    time_t now = time(NULL);
+    struct dirent *item;
+    while ((item = readdir(dir)) != NULL) {
+        const char *name = item->d_name;
+        size_t length = strlen(name);
+        int isEntry = length > 6 && strcmp(name + length - 6, ".entry") == 0;
+        int isTemp = strncmp(name, "tmp.", 4) == 0;
+        if (!isEntry && !isTemp) continue;
+
+        char *path = (char *)malloc(strlen(directory) + length + 2);
+        sprintf(path, "%s/%s", directory, name);
+        struct stat info;
+        if (stat(path, &info) != 0) {  // removed by another compile meanwhile
+            free(path);
+            continue;
+        }
+        if (isTemp) {
+            if (now - info.st_mtime > CACHE_STALE_TEMP_SECONDS) unlink(path);
+            free(path);
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            files = (cache_file *)realloc(files, capacity * sizeof(cache_file));
+        }
+        files[count].path = path;
+        files[count].size = (long long)info.st_size;
+        files[count].used = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+        total += files[count].size;
+        count++;
+    }
+    closedir(dir);
+
+    if (total > maxBytes) {
+        qsort(files, count, sizeof(cache_file), compare_used);
+        for (int i = 0; i < count && total > maxBytes; i++) {
+            if (unlink(files[i].path) == 0 || errno == ENOENT) total -= files[i].size;  // another compile may have won the race
+        }
+    }
+    for (int i = 0; i < count; i++) free(files[i].path);
+    free(files);
+}
+
+int cache_store(const char *directory, long long maxBytes, const cache_blob *key, const cache_entry *entry) {
+    long long size = (long long)(sizeof(CACHE_MAGIC) - 1 + 6 * sizeof(uint64_t) + key->length + entry->log.length +
+                                 entry->mixal.length + entry->lines.length + entry->image.length + entry->output.length);
+    if (size > maxBytes) return -1;  // would evict everything else and still not fit
+
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating cache directory %s!\n", directory);
+        return -1;
+    }
+
+    // write under a unique temporary name, then rename: readers see the old entry or the whole new one
+    char *temp = (char *)malloc(strlen(directory) + 16);
+    sprintf(temp, "%s/tmp.XXXXXX", directory);
+    int fd = mkstemp(temp);
+    if (fd >= 0) fchmod(fd, 0644);  // mkstemp creates it private, entries are meant to be shared
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (file == NULL) {
+        if (fd >= 0) close(fd);
+        free(temp);
+        return -1;
+    }
+
+    int failed = fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC) - 1, file) != sizeof(CACHE_MAGIC) - 1;
+    failed = failed || write_section(file, key) != 0 || write_section(file, &entry->log) != 0 ||
+             write_section(file, &entry->mixal) != 0 || write_section(file, &entry->lines) != 0 ||
+             write_section(file, &entry->image) != 0 || write_section(file, &entry->output) != 0;
+    failed = fclose(file) != 0 || failed;
+
+    char *path = entry_path(directory, key);
+    if (!failed) failed = rename(temp, path) != 0;
+    if (failed) unlink(temp);
+    free(path);
+    free(temp);
+
+    evict(directory, maxBytes);
+    return failed ? -1 : 0;
+}
+
+void cache_entry_free(cache_entry *entry) {
+    free(entry->log.data);
+    free(entry->mixal.data);
+    free(entry->lines.data);
+    free(entry->image.data);
+    free(entry->output.data);
+    memset(entry, 0, sizeof(*entry));
+}
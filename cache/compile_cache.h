@@ -0,0 +1,32 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include "../compiler/compiler_context.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_DEFAULT_MEGABYTES 64  // --cache-size when only --cache-dir is given
+
+typedef struct {
+    char *data;     // malloc'd bytes, not terminated
+    size_t length;
+} cache_blob;
+
+typedef struct {
+    cache_blob log;     // compiler log up to the statistics section
+    cache_blob mixal;   // generated mixal
+    cache_blob lines;   // its line map
+    cache_blob image;   // the image or card deck, empty when emitting MIXAL
+    cache_blob output;  // what expand_node printed
+} cache_entry;
+
+int cache_read_stream(FILE *file, cache_blob *blob);  // read the rest of a stream, 0 on success
+int cache_read_file(const char *path, cache_blob *blob);  // read a whole file, 0 on success
+void cache_key(const compiler_options *options, const cache_blob *source, cache_blob *key);  // everything the artifacts depend on
+int cache_lookup(const char *directory, const cache_blob *key, cache_entry *entry);  // 1 and a filled entry on a hit, 0 on a miss
+int cache_store(const char *directory, long long maxBytes, const cache_blob *key, const cache_entry *entry);  // publish atomically and evict, 0 on success
+void cache_entry_free(cache_entry *entry);
+
+#endif
@@ -0,0 +1,115 @@
+#include "compiler_context.h"
+#include "../cache/compile_cache.h"
+
+#include <pthread.h>
+
+// copy of path with its extension replaced, or extension appended when it has none
+static char *with_extension(const char *path, const char *extension) {
+    const char *base = strrchr(path, '/');
+    const char *dot = strrchr(base != NULL ? base : path, '.');
+    size_t stem = dot != NULL ? (size_t)(dot - path) : strlen(path);
+
+    char *result = (char *)malloc(stem + strlen(extension) + 1);
+    memcpy(result, path, stem);
+    strcpy(result + stem, extension);
+    return result;
+}
+
+void init_compiler_options(compiler_options *options) {
+    memset(options, 0, sizeof(*options));
+    options->statsFormat = STATS_OFF;
+    options->traceLevel = TRACE_TOKENS;  // the log keeps every token and reduction unless asked otherwise
+    options->cacheMaxBytes = CACHE_DEFAULT_MEGABYTES * 1024LL * 1024;
+}
+
+void init_compiler_context(compiler_context *context, const char *inputPath, const compiler_options *options) {
+    memset(context, 0, sizeof(*context));
+    context->inputPath = inputPath;
+    context->options = *options;
+    context->traceLevel = options->traceLevel;
+    context->logPath = inputPath != NULL ? with_extension(inputPath, ".log") : strdup("log.txt");
+    context->mixalPath = inputPath != NULL ? with_extension(inputPath, ".mixal") : strdup("mix.mixal");
+    context->mapPath = inputPath != NULL ? with_extension(inputPath, ".map") : strdup("mix.map");
+    if (options->emitFormat != EMIT_MIXAL) {
+        const char *extension = options->emitFormat == EMIT_IMAGE ? ".img" : ".deck";
+        context->imagePath = inputPath != NULL ? with_extension(inputPath, extension) : with_extension("mix", extension);
+    }
+    context->outputPath = inputPath != NULL ? with_extension(inputPath, ".out") : NULL;
+    context->statsPath = inputPath != NULL ? with_extension(inputPath, ".stats.json") : strdup("stats.json");
+
+    arena_init(&context->astArena, 64 * 1024);  // nodes and names are carved out of 64KB blocks
+    init_name_pool(&context->names, &context->astArena);  // interned names live next to the nodes
+    init_symbol_table(&context->symbolTable);  // start with an empty symbol table
+}
+
+void free_compiler_context(compiler_context *context) {
+    if (context->logFile != NULL) fclose(context->logFile);
+    if (context->outputFile != NULL && context->outputFile != stdout) fclose(context->outputFile);
+    free(context->writtenValues);  // release the printed values
+    free_symbol_table(&context->symbolTable);  // release symbols
+    free_name_pool(&context->names);  // release the name index
+    arena_destroy(&context->astArena);  // release the whole tree in one operation
+    free(context->logPath);
+    free(context->mixalPath);
+    free(context->mapPath);
+    free(context->imagePath);
+    free(context->outputPath);
+    free(context->statsPath);
+    memset(context, 0, sizeof(*context));
+}
+
+typedef struct {
+    const char **paths;
+    int count;
+    int next;             // index of the next file to hand out
+    int failures;
+    long long cacheHits;  // summed over every file for the --cache-dir report
+    long long cacheMisses;
+    const compiler_options *options;  // shared read-only by every worker
+    pthread_mutex_t lock;  // guards next, failures and the cache counters
+} batch_queue;
+
+static void *batch_worker(void *argument) {
+    batch_queue *queue = (batch_queue *)argument;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        int index = queue->next < queue->count ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (index < 0) break;
+
+        compiler_context context;  // every file gets its own state, nothing is shared between threads
+        init_compiler_context(&context, queue->paths[index], queue->options);
+        int failed = compile_unit(&context) != 0;
+
+        pthread_mutex_lock(&queue->lock);
+        if (failed) queue->failures++;
+        queue->cacheHits += context.stats.counters[COUNTER_CACHE_HITS];
+        queue->cacheMisses += context.stats.counters[COUNTER_CACHE_MISSES];
+        pthread_mutex_unlock(&queue->lock);
+        free_compiler_context(&context);
+    }
+    return NULL;
+}
+
+int compile_batch(const char **paths, int count, int jobs, const compiler_options *options) {
+    batch_queue queue = {paths, count, 0, 0, 0, 0, options, PTHREAD_MUTEX_INITIALIZER};
+    if (jobs > count) jobs = count;
+    if (jobs < 1) jobs = 1;
+
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 1; i < jobs; i++) {  // the calling thread is the last worker
+        if (pthread_create(&threads[started], NULL, batch_worker, &queue) != 0) break;
+        started++;
+    }
+    batch_worker(&queue);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&queue.lock);
+    if (options->cacheDirectory != NULL) {
+        fprintf(stderr, "Cache %s: %lld hits, %lld misses\n", options->cacheDirectory, queue.cacheHits, queue.cacheMisses);
+    }
+    return queue.failures;
+}
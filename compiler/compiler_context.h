@@ -0,0 +1,64 @@
+#ifndef COMPILER_CONTEXT_H
+#define COMPILER_CONTEXT_H
+
+#include "../arena/arena.h"
+#include "../symbol_table/symbol_table.h"
+#include "../syntax_tree/syntax_tree.h"
+#include "../stats/compile_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    EMIT_MIXAL,  // MIXAL text for an external assembler
+    EMIT_IMAGE,  // binary memory image from the built-in assembler
+    EMIT_DECK    // card deck for Knuth's loading routine
+} emit_format;
+
+typedef struct {
+    int simulate;                 // run the generated program on the built-in MIX simulator
+    const char *simulationInput;  // input records for the simulator, NULL for none
+    stats_format statsFormat;     // per-phase timing and counters, off by default
+    int traceLevel;               // TRACE_NONE, TRACE_PARSER or TRACE_TOKENS lines in the log
+    int printCfg;                 // append the basic blocks and their live variables to the log
+    long long partialEvalSteps;   // --peval: steps run at compile time before the rest is compiled, 0 compiles the program as written
+    int profile;                  // --profile: count block runs in MIX memory and report them per source line after --simulate
+    emit_format emitFormat;       // what the generated program is written as, MIXAL by default
+    int listing;                  // --listing: write the MIXAL as well when emitting an image or a deck
+    const char *cacheDirectory;   // reuse artifacts of unchanged sources from here, NULL disables the cache
+    long long cacheMaxBytes;      // least recently used entries are evicted above this size
+} compiler_options;
+
+typedef struct compiler_context_tag {
+    const char *inputPath;        // source file, NULL reads stdin
+    char *logPath;                // where the compiler log is written
+    char *mixalPath;              // where the generated mixal is written
+    char *mapPath;                // where the source line of every instruction is written
+    char *imagePath;              // where the image or card deck is written, NULL when emitting MIXAL
+    char *outputPath;             // where the program's writes go, NULL for stdout
+    char *statsPath;              // where --stats=json writes its report
+    compiler_options options;     // command line settings
+    int traceLevel;               // copy of options.traceLevel for the TRACE macro
+
+    FILE *logFile;                // compiler log of this compilation
+    FILE *outputFile;             // program output of expand_node
+    struct TreeNode *root;        // root of the syntax tree, NULL until parsed
+    arena astArena;               // owns every tree node and interned name of this compilation
+    name_pool names;              // interned identifiers
+    symbol_table symbolTable;     // hashed table of all symbols
+
+    int *writtenValues;           // values printed by expand_node, in order
+    int writtenCount;             // number of printed values
+    int writtenCapacity;          // allocated size of writtenValues
+    int failed;                   // input missing or not parsable
+    compile_stats stats;          // phase times and counters
+} compiler_context;
+
+void init_compiler_options(compiler_options *options);  // defaults: no simulation, no statistics, full trace
+void init_compiler_context(compiler_context *context, const char *inputPath, const compiler_options *options);  // fresh state; file.txt writes file.log, file.mixal, file.map, file.img or file.deck, file.out and file.stats.json
+void free_compiler_context(compiler_context *context);  // release everything the compilation owns
+int compile_unit(compiler_context *context);  // parse and compile one source, 0 on success (defined with the parser in sydc.y)
+int compile_batch(const char **paths, int count, int jobs, const compiler_options *options);  // compile files on a pool of threads, returns the number that failed
+
+#endif
@@ -0,0 +1,375 @@
+#include "bytecode.h"
+
+#define LOG_BUFFER_SIZE 65536  // assignments are logged through one buffer and flushed in large writes
+
+static int emit(bytecode_program *program, opcode op, int dst, int a, int b) {
+    if (program->codeCount == program->codeCapacity) {
+        program->codeCapacity = program->codeCapacity ? program->codeCapacity * 2 : 256;
+        program->code = (instruction *)realloc(program->code, program->codeCapacity * sizeof(instruction));
+    }
+    instruction *in = &program->code[program->codeCount];
+    in->op = op;
+    in->dst = dst;
+    in->a = a;
+    in->b = b;
+    in->assigns = 0;
+    return program->codeCount++;
+}
+
+static int new_register(bytecode_program *program, int initialValue) {
+    if (program->registerCount == program->registerCapacity) {
+        program->registerCapacity = program->registerCapacity ? program->registerCapacity * 2 : 64;
+        program->initialValues = (int *)realloc(program->initialValues, program->registerCapacity * sizeof(int));
+    }
+    program->initialValues[program->registerCount] = initialValue;
+    return program->registerCount++;
+}
+
+// scratch register for an expression result at the given nesting depth
+static int temp_register(bytecode_program *program, int depth) {
+    if (depth >= program->tempCount) {
+        program->tempRegisters = (int *)realloc(program->tempRegisters, (depth + 1) * sizeof(int));
+        while (program->tempCount <= depth) program->tempRegisters[program->tempCount++] = new_register(program, 0);
+    }
+    return program->tempRegisters[depth];
+}
+
+// resolve a variable name to its slot, allocating a slot and register on first sight
+static int slot_for(bytecode_program *program, const char *name) {
+    int index = name_map_index(&program->slotIndex, name);
+    if (index < program->slotCount) return index;  // seen before
+
+    if (program->slotCount == program->slotCapacity) {
+        program->slotCapacity = program->slotCapacity ? program->slotCapacity * 2 : 64;
+        program->slots = (variable_slot *)realloc(program->slots, program->slotCapacity * sizeof(variable_slot));
+    }
+    variable_slot *slot = &program->slots[program->slotCount];
+    slot->name = name;
+    slot->reg = new_register(program, 0);  // variables start at 0
+    slot->logPrefixLength = (int)strlen(name) + 5;
+    slot->logPrefix = (char *)calloc(slot->logPrefixLength + 32, 1);  // padded so short prefixes copy in one fixed block
+    snprintf(slot->logPrefix, slot->logPrefixLength + 1, "(%s -> ", name);
+    return program->slotCount++;
+}
+
+static opcode binary_opcode(NodeType type) {
+    switch (type) {
+        case NODE_ADD: return OP_ADD;
+        case NODE_SUBTRACT: return OP_SUBTRACT;
+        case NODE_MULTIPLY: return OP_MULTIPLY;
+        case NODE_DIVIDE: return OP_DIVIDE;
+        case NODE_LT: return OP_LT;
+        default: return OP_EQ;
+    }
+}
+
+static int is_binary(TreeNode *node) {
+    return node != NULL && (node->type == NODE_ADD || node->type == NODE_SUBTRACT || node->type == NODE_MULTIPLY ||
+                            node->type == NODE_DIVIDE || node->type == NODE_LT || node->type == NODE_EQ);
+}
+
+typedef struct {
+    TreeNode *node;
+    int depth;   // nesting depth, selecting the scratch register
+    int target;  // register receiving the result, or -1
+    int step;    // operands lowered so far
+    int left;    // register holding the left operand once it is lowered
+} expression_frame;
+
+// register holding a leaf; missing and unknown expressions evaluate to 0
+static int compile_leaf(bytecode_program *program, TreeNode *node) {
+    if (node != NULL && node->type == NODE_NUMBER) {
+        return new_register(program, node->number);
+    }
+    if (node != NULL && node->type == NODE_ID) {
+        int slot = slot_for(program, node->value);  // may grow the slot array
+        return program->slots[slot].reg;  // variables are used in place
+    }
+    return new_register(program, 0);
+}
+
+// return the register holding the value of an expression; target (or -1) receives the result of an operator
+static int compile_expression(bytecode_program *program, TreeNode *node, int depth, int target) {
+    work_stack *stack = &program->expressionStack;  // operator chains can be far deeper than the C stack
+    expression_frame *frame = (expression_frame *)work_stack_push(stack);
+    frame->node = node;
+    frame->depth = depth;
+    frame->target = target;
+    int result = 0;  // register of the most recently finished operand
+
+    while (stack->count > 0) {
+        frame = (expression_frame *)work_stack_top(stack);
+        if (!is_binary(frame->node)) {
+            result = compile_leaf(program, frame->node);
+            work_stack_pop(stack);
+            continue;
+        }
+
+        TreeNode *operand = NULL;
+        int operandDepth = 0;
+        if (frame->step == 0) {
+            operand = frame->node->left;
+            operandDepth = frame->depth + 1;
+        } else if (frame->step == 1) {
+            frame->left = result;
+            operand = frame->node->right;
+            operandDepth = frame->depth + 2;
+        } else {
+            int dst = frame->target >= 0 ? frame->target : temp_register(program, frame->depth);
+            emit(program, binary_opcode(frame->node->type), dst, frame->left, result);
+            result = dst;
+            work_stack_pop(stack);
+            continue;
+        }
+
+        frame->step++;
+        expression_frame *child = (expression_frame *)work_stack_push(stack);  // frame is stale from here on
+        child->node = operand;
+        child->depth = operandDepth;
+        child->target = -1;
+    }
+    return result;
+}
+
+// emit a jump to target taken when the condition is false, fusing the comparison when possible
+static void compile_jump_unless(bytecode_program *program, TreeNode *condition, int target, int *patch) {
+    int at;
+    if (condition != NULL && (condition->type == NODE_LT || condition->type == NODE_EQ)) {
+        int left = compile_expression(program, condition->left, 1, -1);
+        int right = compile_expression(program, condition->right, 2, -1);
+        at = emit(program, condition->type == NODE_LT ? OP_JUMP_UNLESS_LT : OP_JUMP_UNLESS_EQ, target, left, right);
+    } else {
+        int value = compile_expression(program, condition, 0, -1);
+        at = emit(program, OP_JUMP_IF_FALSE, target, value, 0);
+    }
+    if (patch != NULL) *patch = at;
+}
+
+static void compile_statement(bytecode_program *program, TreeNode *node) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            compile_statement(program, node->left);
+            break;
+        case NODE_SEQ:
+            for (int i = 0; i < node->count; i++) {
+                compile_statement(program, node->items[i]);  // only nested if/repeat bodies recurse
+            }
+            break;
+        case NODE_ASSIGNMENT: {
+            int slot = slot_for(program, node->left->value);
+            int reg = program->slots[slot].reg;
+            if (is_binary(node->right)) {
+                compile_expression(program, node->right, 0, reg);  // compute straight into the variable
+            } else {
+                emit(program, OP_MOVE, reg, compile_expression(program, node->right, 0, -1), 0);
+            }
+            program->code[program->codeCount - 1].assigns = slot + 1;  // the last instruction also logs it
+            break;
+        }
+        case NODE_IF: {
+            int skipThen;
+            compile_jump_unless(program, node->left, 0, &skipThen);
+            if (node->right && node->right->type == NODE_ELSE) {
+                compile_statement(program, node->right->left);  // then branch
+                int skipElse = emit(program, OP_JUMP, 0, 0, 0);
+                program->code[skipThen].dst = program->codeCount;
+                compile_statement(program, node->right->right);  // else branch
+                program->code[skipElse].dst = program->codeCount;
+            } else {
+                compile_statement(program, node->right);
+                program->code[skipThen].dst = program->codeCount;
+            }
+            break;
+        }
+        case NODE_REPEAT: {
+            int loopStart = program->codeCount;
+            compile_statement(program, node->left);  // body runs at least once
+            compile_jump_unless(program, node->right, loopStart, NULL);  // repeat until the condition holds
+            break;
+        }
+        case NODE_READ: {
+            int slot = slot_for(program, node->value);
+            emit(program, OP_READ, 0, program->slots[slot].reg, slot);
+            break;
+        }
+        case NODE_WRITE: {
+            int slot = slot_for(program, node->value);
+            emit(program, OP_WRITE, 0, program->slots[slot].reg, slot);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void compile_program(bytecode_program *program, TreeNode *root) {
+    memset(program, 0, sizeof(*program));
+    init_name_map(&program->slotIndex);
+    work_stack_init(&program->expressionStack, sizeof(expression_frame));
+    compile_statement(program, root);
+    emit(program, OP_HALT, 0, 0, 0);
+    work_stack_free(&program->expressionStack);
+}
+
+static symbol *declare(symbol **symbols, int slot, const char *name, symbol_table *symbolTable) {
+    if (symbols[slot] == NULL) {
+        symbol *sym = find_symbol(name, symbolTable);
+        if (sym == NULL) {
+            sym = create_symbol(symbolTable, name);  // create new symbol if not found
+            add_symbol(sym, symbolTable);  // add it to the symbol table
+        }
+        symbols[slot] = sym;
+    }
+    return symbols[slot];
+}
+
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// append "(name -> value)\n" to the log buffer
+static int log_assignment(char *buffer, int used, const variable_slot *slot, int value) {
+    char digits[24];
+    char *end = digits + 12;  // the slack after it lets the fixed-size copy below stay inside the array
+    char *p = end;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    while (magnitude >= 100) {  // two digits per division
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--p = digitPairs[pair + 1];
+        *--p = digitPairs[pair];
+    }
+    if (magnitude >= 10) {
+        *--p = digitPairs[magnitude * 2 + 1];
+        *--p = digitPairs[magnitude * 2];
+    } else {
+        *--p = (char)('0' + magnitude);
+    }
+
+    char *out = buffer + used;
+    if (slot->logPrefixLength <= 32) {
+        memcpy(out, slot->logPrefix, 32);  // fixed-size copy, the buffer keeps slack for it
+    } else {
+        memcpy(out, slot->logPrefix, slot->logPrefixLength);
+    }
+    out += slot->logPrefixLength;
+    if (value < 0) *out++ = '-';
+    memcpy(out, p, 12);  // fixed-size copy, the buffer keeps slack for it
+    out += end - p;
+    *out++ = ')';
+    *out++ = '\n';
+    return (int)(out - buffer);
+}
+
+long long run_program(bytecode_program *program, symbol_table *symbolTable, FILE *logFile, FILE *output, void (*onWrite)(void *user, int value), void *user) {
+    int *r = (int *)malloc((program->registerCount + 1) * sizeof(int));
+    symbol **symbols = (symbol **)calloc(program->slotCount + 1, sizeof(symbol *));  // created on first assignment or read
+    char *logBuffer = (char *)malloc(LOG_BUFFER_SIZE);
+    int logUsed = 0;
+
+    memcpy(r, program->initialValues, program->registerCount * sizeof(int));  // constants and zeroed variables
+    for (int i = 0; i < program->slotCount; i++) {  // variables known from earlier passes keep their values
+        symbols[i] = find_symbol(program->slots[i].name, symbolTable);
+        if (symbols[i] != NULL) r[program->slots[i].reg] = symbols[i]->value;
+    }
+
+    const instruction *code = program->code;
+    const instruction *in = code;
+    long long steps = 1;  // the final HALT
+    for (;; in++, steps++) {
+        switch (in->op) {  // value-producing operations fall out of the switch only to log an assignment
+            case OP_MOVE:
+                r[in->dst] = r[in->a];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_ADD:
+                r[in->dst] = r[in->a] + r[in->b];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_SUBTRACT:
+                r[in->dst] = r[in->a] - r[in->b];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_MULTIPLY:
+                r[in->dst] = r[in->a] * r[in->b];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_DIVIDE:
+                if (r[in->b] == 0) {
+                    fprintf(stderr, "Semantic Error: division by zero\n");
+                    r[in->dst] = 0;
+                } else {
+                    r[in->dst] = r[in->a] / r[in->b];
+                }
+                if (in->assigns == 0) continue;
+                break;
+            case OP_LT:
+                r[in->dst] = r[in->a] < r[in->b];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_EQ:
+                r[in->dst] = r[in->a] == r[in->b];
+                if (in->assigns == 0) continue;
+                break;
+            case OP_READ:
+                declare(symbols, in->b, program->slots[in->b].name, symbolTable);
+                continue;
+            case OP_WRITE:
+                if (symbols[in->b] != NULL) {
+                    fprintf(output, "%d", r[in->a]);  // print symbol value
+                    if (onWrite != NULL) onWrite(user, r[in->a]);
+                } else {
+                    fprintf(output, "Semantic Error: variable %s not found", program->slots[in->b].name);
+                }
+                continue;
+            case OP_JUMP:
+                in = code + in->dst - 1;
+                continue;
+            case OP_JUMP_IF_FALSE:
+                if (r[in->a] == 0) in = code + in->dst - 1;
+                continue;
+            case OP_JUMP_UNLESS_LT:
+                if (!(r[in->a] < r[in->b])) in = code + in->dst - 1;
+                continue;
+            case OP_JUMP_UNLESS_EQ:
+                if (r[in->a] != r[in->b]) in = code + in->dst - 1;
+                continue;
+            case OP_HALT:
+                goto done;
+        }
+
+        int slotIndex = in->assigns - 1;  // an assignment: declare the variable and log its new value
+        const variable_slot *slot = &program->slots[slotIndex];
+        if (symbols[slotIndex] == NULL) declare(symbols, slotIndex, slot->name, symbolTable);
+        if (logUsed + slot->logPrefixLength + 64 > LOG_BUFFER_SIZE) {
+            fwrite(logBuffer, 1, logUsed, logFile);  // flush a full buffer
+            logUsed = 0;
+        }
+        logUsed = log_assignment(logBuffer, logUsed, slot, r[in->dst]);
+    }
+
+done:
+    fwrite(logBuffer, 1, logUsed, logFile);
+    for (int i = 0; i < program->slotCount; i++) {  // publish final values to the symbol table
+        if (symbols[i] != NULL) symbols[i]->value = r[program->slots[i].reg];
+    }
+    free(logBuffer);
+    free(symbols);
+    free(r);
+    return steps;
+}
+
+void free_program(bytecode_program *program) {
+    for (int i = 0; i < program->slotCount; i++) {
+        free(program->slots[i].logPrefix);
+    }
+    free(program->code);
+    free(program->initialValues);
+    free(program->slots);
+    free_name_map(&program->slotIndex);
+    free(program->tempRegisters);
+    memset(program, 0, sizeof(*program));
+}
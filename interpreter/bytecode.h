@@ -0,0 +1,64 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "../syntax_tree/node_types.h"
+#include "../syntax_tree/syntax_tree.h"
+#include "../symbol_table/symbol_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    OP_MOVE,            // r[dst] = r[a]
+    OP_ADD,             // r[dst] = r[a] + r[b]
+    OP_SUBTRACT,        // r[dst] = r[a] - r[b]
+    OP_MULTIPLY,        // r[dst] = r[a] * r[b]
+    OP_DIVIDE,          // r[dst] = r[a] / r[b]
+    OP_LT,              // r[dst] = r[a] < r[b]
+    OP_EQ,              // r[dst] = r[a] == r[b]
+    OP_READ,            // declare variable b (reads see no input at compile time)
+    OP_WRITE,           // print variable b (held in r[a])
+    OP_JUMP,            // continue at dst
+    OP_JUMP_IF_FALSE,   // continue at dst when r[a] is zero
+    OP_JUMP_UNLESS_LT,  // continue at dst unless r[a] < r[b]
+    OP_JUMP_UNLESS_EQ,  // continue at dst unless r[a] == r[b]
+    OP_HALT             // end of program
+} opcode;
+
+typedef struct {
+    opcode op;  // operation
+    int dst;    // destination register or jump target
+    int a;      // first source register
+    int b;      // second source register, or variable index for READ/WRITE
+    int assigns;  // 1 + variable index when r[dst] is a variable whose assignment is logged, else 0
+} instruction;
+
+typedef struct {
+    const char *name;   // interned variable name
+    int reg;            // register holding the variable
+    char *logPrefix;    // "(name -> " ready to be copied into the log
+    int logPrefixLength;
+} variable_slot;
+
+typedef struct {
+    instruction *code;      // flat instruction array
+    int codeCount;
+    int codeCapacity;
+    int *initialValues;     // starting contents of every register (constants are pre-parsed here)
+    int registerCount;
+    int registerCapacity;
+    variable_slot *slots;   // one entry per distinct variable
+    int slotCount;
+    int slotCapacity;
+    name_map slotIndex;     // interned name -> slot
+    int *tempRegisters;     // scratch register reserved for each expression depth
+    int tempCount;
+    work_stack expressionStack;  // operators still being lowered by compile_expression
+} bytecode_program;
+
+void compile_program(bytecode_program *program, TreeNode *root);  // lower the ast to bytecode
+long long run_program(bytecode_program *program, symbol_table *symbolTable, FILE *logFile, FILE *output, void (*onWrite)(void *user, int value), void *user);  // execute it, printing writes to output; returns instructions executed
+void free_program(bytecode_program *program);  // release the bytecode
+
+#endif
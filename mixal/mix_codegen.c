@@ -3,321 +3,878 @@
 #include "../syntax_tree/syntax_tree.h"
 #include "../symbol_table/symbol_table.h"
 
+#include <stdint.h>
+
 #define DEBUG 0
 
-FILE *mixFile;                // file pointer for mixal code
-static int if_label_count = 0;  // Counter for generating unique if-statement labels
-static int repeat_label_count = 0;  // Counter for generating unique repeat-statement labels
-static int write_label_count = 0; // Counter for generating unique write labels
-static int temp_count = 1;  // Counter for generating unique temporary variables
-extern symbol *symbolList;  // External symbol list pointer
+#define INPUT_DEVICE 19     // typewriter, one number per record
+#define PRINTER_DEVICE 18   // line printer
+#define INPUT_REGISTER 5    // offset of the input buffer holding the next record, 0 or MIX_INPUT_WORDS
+#define OUTPUT_REGISTER 6   // address of the next free slot in the line being filled
+#define SLOT_WORDS 3        // a printed value: a word ending in its sign, then ten digits
+
+typedef struct {
+    mix_ir ir;                 // instructions generated so far
+    symbol_table *symbols;     // variables and their memory locations
+    storage_plan *storage;     // packed words of the variables and free words for spills
+    int position;              // statement position, numbered like plan_storage does
+    int *blockLabels;          // label of every block of the graph
+    char *readFollows;         // per block: another read may run after control leaves it
+    int printLabel;            // routine printing the value in rA, -1 when the program never writes
+    int printCharsLabel;       // its entry for a value already in characters, sign in rA and digits in rAX
+    int finishLabel;           // prints the last partial line and halts
+    int *counters;             // --profile: word counting the runs of each block, NULL otherwise
+    const loop_plan *loops;    // loop variables kept in index registers
+    const induction_variable **registers; // per block and index register: the variable it holds there, NULL for none
+    const induction_variable **held;      // the row of the block being generated
+    int *preheaderOf;          // per block: loop whose registers it loads before jumping in, -1 for none
+    int *exitOf;               // per block: loop whose registers it stores back on entry, -1 for none
+    int synced[LOOP_REGISTERS + 1]; // the variable's word holds what its index register does
+    int compareLabelCount;     // Counter for generating unique comparison-value labels
+    int spillDepth;            // Spill slots currently holding live values
+    work_stack expressionStack; // Operators still being generated
+    work_stack needStack;      // Operators whose Sethi-Ullman label is being computed
+    const TreeNode **needNodes; // Labels already computed, keyed by node (open addressing)
+    int *needs;
+    int needCount;
+    int needCapacity;
+} codegen_state;
+
+typedef enum {
+    PLAN_RIGHT_LEAF,  // left into rA, right straight from memory
+    PLAN_LEFT_LEAF,   // right into rA, left straight from memory
+    PLAN_SPILL        // first operand spilled to a free word while the second is evaluated
+} operand_plan;
+
+typedef struct {
+    TreeNode *node;
+    int condition;     // set the comparison indicator rather than leave the value in rA
+    int keepIndicator; // comparison turned into 0 or 1: rA is overwritten before the jump, so no register jumps
+    int step;          // operands generated so far
+    operand_plan plan;
+    TreeNode *second;  // operand evaluated after the spill
+    int temp;          // address of the spilled first operand
+} expression_frame;
+
+typedef struct {
+    const TreeNode *node;
+    int isLeftOperand;
+    int step;          // operands labelled so far
+    int left;          // label of the left operand
+} need_frame;
+
+static int fits_in_address(int number) {
+    return number >= -4095 && number <= 4095;  // ENTA, INCA and DECA only have a two-byte address field
+}
+
+static int is_leaf(const TreeNode *node) {
+    return node->type == NODE_NUMBER || node->type == NODE_ID;  // usable directly as a memory operand
+}
 
+static size_t need_hash(const TreeNode *node, int capacity) {
+    return (size_t)(((uintptr_t)node >> 3) * 2654435761u) & (size_t)(capacity - 1);
+}
 
-void createMixFile() {
-    mixFile = fopen("mix.mixal", "w");  // open log file for writing
-    if (mixFile == NULL) {
-        fprintf(stderr, "ERROR: Can not open mixal file.\n");  // print error message if file cannot be opened
+static void remember_need(codegen_state *state, const TreeNode *node, int need) {
+    if (2 * (state->needCount + 1) > state->needCapacity) {  // keep the table at most half full
+        const TreeNode **oldNodes = state->needNodes;
+        int *oldNeeds = state->needs;
+        int oldCapacity = state->needCapacity;
+        state->needCapacity = oldCapacity ? oldCapacity * 2 : 256;
+        state->needNodes = (const TreeNode **)calloc(state->needCapacity, sizeof(TreeNode *));
+        state->needs = (int *)malloc(state->needCapacity * sizeof(int));
+        state->needCount = 0;
+        for (int i = 0; i < oldCapacity; i++) {
+            if (oldNodes[i] != NULL) remember_need(state, oldNodes[i], oldNeeds[i]);
+        }
+        free(oldNodes);
+        free(oldNeeds);
     }
+    size_t i = need_hash(node, state->needCapacity);
+    while (state->needNodes[i] != NULL) i = (i + 1) & (size_t)(state->needCapacity - 1);
+    state->needNodes[i] = node;
+    state->needs[i] = need;
+    state->needCount++;
 }
 
-int is_numeric(const char *str) {
-    if (str == NULL || *str == '\0') {
-        return 0; // Empty or null string is not numeric
+static int lookup_need(const codegen_state *state, const TreeNode *node) {
+    if (state->needCapacity == 0) return -1;
+    size_t i = need_hash(node, state->needCapacity);
+    while (state->needNodes[i] != NULL) {
+        if (state->needNodes[i] == node) return state->needs[i];
+        i = (i + 1) & (size_t)(state->needCapacity - 1);
     }
+    return -1;
+}
 
-    while (*str) {
-        if (!isdigit((unsigned char)*str)) {
-            return 0; // Non-digit character found
+// Sethi-Ullman label: how many values must be held at once to evaluate the node into rA;
+// labels are remembered so spilling along a long operator chain stays linear
+static int registers_needed(codegen_state *state, const TreeNode *node, int isLeftOperand) {
+    work_stack *stack = &state->needStack;
+    need_frame *frame = (need_frame *)work_stack_push(stack);
+    frame->node = node;
+    frame->isLeftOperand = isLeftOperand;
+    int result = 0;  // label of the most recently finished operand
+
+    while (stack->count > 0) {
+        frame = (need_frame *)work_stack_top(stack);
+        if (is_leaf(frame->node)) {
+            result = frame->isLeftOperand ? 1 : 0;  // a right leaf is addressed in memory, never loaded
+            work_stack_pop(stack);
+            continue;
         }
-        str++;
+
+        const TreeNode *operand;
+        if (frame->step == 0) {
+            int known = lookup_need(state, frame->node);
+            if (known >= 0) {
+                result = known;
+                work_stack_pop(stack);
+                continue;
+            }
+            operand = frame->node->left;
+        } else if (frame->step == 1) {
+            frame->left = result;
+            operand = frame->node->right;
+        } else {
+            int left = frame->left;
+            result = left == result ? left + 1 : (left > result ? left : result);
+            remember_need(state, frame->node, result);
+            work_stack_pop(stack);
+            continue;
+        }
+
+        int isLeft = frame->step++ == 0;
+        need_frame *child = (need_frame *)work_stack_push(stack);  // frame is stale from here on
+        child->node = operand;
+        child->isLeftOperand = isLeft;
     }
+    return result;
+}
 
-    return 1; // All characters were digits
+// the loop variable of that name when an index register holds it in the current block
+static const induction_variable *register_holding(const codegen_state *state, const char *name) {
+    for (int reg = 1; reg <= LOOP_REGISTERS; reg++) {
+        if (state->held[reg] != NULL && state->held[reg]->name == name) return state->held[reg];
+    }
+    return NULL;
 }
 
-static void generate_expression(TreeNode *node) {
-    if (node == NULL) return;
+static const induction_variable *held_in_register(const codegen_state *state, const TreeNode *node) {
+    return node->type == NODE_ID ? register_holding(state, node->value) : NULL;
+}
 
-    switch (node->type) {
-        case NODE_NUMBER:
-            if (DEBUG) printf("NODE_NUMBER\n");  // For debugging
-            fprintf(mixFile, " ENTA %s\n", node->value);  // Load the number into the accumulator
-            break;
-        case NODE_ID:
-            if (DEBUG) printf("NODE_ID\n");  // For debugging
+// copy an index register into its variable's word
+static void store_register(codegen_state *state, const induction_variable *induction) {
+    int address = storage_address(state->storage, induction->name);
+    if (address >= 0) mix_ir_emit(&state->ir, mix_index_opcode(MIX_ST1, induction->reg), mix_number(address), -1);
+    state->synced[induction->reg] = 1;
+}
 
-            symbol *sym = find_symbol(node->value, symbolList);
-            if (sym != NULL) {
-                fprintf(mixFile, " LDA %d\n", sym->memoryLocation);  // Load the variable value into the accumulator using its memory address
-            }
+// memory operand for a leaf: a variable address or a literal constant
+static mix_address leaf_operand(codegen_state *state, const TreeNode *node) {
+    if (node->type == NODE_NUMBER) return mix_literal(node->number);
 
-            break;
-       case NODE_ADD:
-            if (DEBUG) printf("NODE_ADD\n");  // For debugging
-            int addTemp = temp_count;
-            // Generate code for left operand
-            generate_expression(node->left);
-            // Store result temporarily
-            fprintf(mixFile, " STA TEMP%d\n", addTemp);
-            temp_count++;
-            // Generate code for right operand
-            generate_expression(node->right);
-            // Load temporary result and add
-            fprintf(mixFile, " ADD TEMP%d\n", addTemp);  // Load previous temp
-            break;
+    const induction_variable *held = held_in_register(state, node);
+    if (held != NULL && !state->synced[held->reg]) store_register(state, held);  // MUL, DIV and CMPA only read memory
+
+    int address = storage_address(state->storage, node->value);
+    if (address >= 0) return mix_number(address);
+    return mix_literal(0);  // never assigned, reads as zero like an untouched word
+}
+
+static void load_leaf(codegen_state *state, const TreeNode *node) {
+    if (node->type == NODE_NUMBER && fits_in_address(node->number)) {
+        mix_ir_emit(&state->ir, MIX_ENTA, mix_number(node->number), -1);  // Small numbers come from the address field
+        return;
+    }
+    const induction_variable *held = held_in_register(state, node);
+    if (held != NULL) {
+        mix_ir_emit(&state->ir, MIX_ENTA, mix_indexed(0, held->reg), -1);  // rA = 0 + rIi, no memory access
+        return;
+    }
+    mix_ir_emit(&state->ir, MIX_LDA, leaf_operand(state, node), -1);  // Variables and large numbers come from memory
+}
+
+// combine rA with an operand in memory, leaving the result in rA
+static void apply_operator(codegen_state *state, NodeType type, mix_address operand) {
+    switch (type) {
+        case NODE_ADD:
         case NODE_SUBTRACT:
-            if (DEBUG) printf("NODE_SUBTRACT\n");  // For debugging
-            int subTemp = temp_count;
-            // Generate code for left operand
-            generate_expression(node->left);
-            // Store result temporarily
-            fprintf(mixFile, " STA TEMP%d\n", subTemp);
-            temp_count++;
-            // Generate code for right operand
-            generate_expression(node->right);
-            // Load temporary result and subtract
-            fprintf(mixFile, " SUB TEMP%d\n", subTemp);  // Load previous temp
-
-            // A = 0-A
-            fprintf(mixFile, " STA OPPTEMP\n");
-            fprintf(mixFile, " ENTA 0\n");
-            fprintf(mixFile, " SUB OPPTEMP\n");
+            if (operand.kind == MIX_ADDRESS_LITERAL && fits_in_address(operand.value)) {
+                mix_ir_emit(&state->ir, type == NODE_ADD ? MIX_INCA : MIX_DECA, mix_number(operand.value), -1);  // Immediate, no memory access
+            } else {
+                mix_ir_emit(&state->ir, type == NODE_ADD ? MIX_ADD : MIX_SUB, operand, -1);
+            }
             break;
         case NODE_MULTIPLY:
-            if (DEBUG) printf("NODE_MULTIPLY\n");  // For debugging
-            int mulTemp = temp_count;
-            // Generate code for left operand
-            generate_expression(node->left);
-            // Store result temporarily
-            fprintf(mixFile, " STA TEMP%d\n", mulTemp);
-            temp_count++;
-            // Generate code for right operand
-            generate_expression(node->right);
-            // Load temporary result and multiply
-            fprintf(mixFile, " MUL TEMP%d\n", mulTemp);  // Load previous temp
-            fprintf(mixFile, " STX TEMP%d\n", mulTemp);
-            fprintf(mixFile, " LDA TEMP%d\n", mulTemp);
-            fprintf(mixFile, " ENTX 0\n");
+            mix_ir_emit(&state->ir, MIX_MUL, operand, -1);
+            mix_ir_emit(&state->ir, MIX_SLAX, mix_number(5), -1);  // Product is in rX, shift it into rA
             break;
         case NODE_DIVIDE:
-            if (DEBUG) printf("NODE_DIVIDE\n");  // For debugging
-            int divTemp = temp_count;
-            // Generate code for left operand
-            generate_expression(node->left);
-            // Store result temporarily
-            fprintf(mixFile, " STA TEMP%d\n", divTemp);
-            temp_count++;
-            // Generate code for right operand
-            generate_expression(node->right);
-            
-            // A = 1/A (Swap A and TEMP)
-            fprintf(mixFile, " STA SWAPTEMP\n");  // swaptemp = A
-            fprintf(mixFile, " LDX SWAPTEMP\n");  // X = swaptemp => X = A
-            fprintf(mixFile, " LDA TEMP%d\n", divTemp);  // A = temp
-            fprintf(mixFile, " STX TEMP%d\n", divTemp);  // temp = X
-            fprintf(mixFile, " STA SWAPTEMP\n");
-            fprintf(mixFile, " LDX SWAPTEMP\n");
-            fprintf(mixFile, " ENTA 0\n");
-            fprintf(mixFile, " DIV TEMP%d\n", divTemp);
-
+            mix_ir_emit(&state->ir, MIX_SRAX, mix_number(5), -1);  // Dividend into rX, rA keeps only its sign
+            mix_ir_emit(&state->ir, MIX_DIV, operand, -1);
             break;
-        case NODE_LT:
-            if (DEBUG) printf("NODE_LT\n");  // For debugging
-            generate_expression(node->left);   // Evaluate left operand
-
-            if (is_numeric(node->right->value)) {
-                fprintf(mixFile, " ENTX %s\n", node->right->value);
-                fprintf(mixFile, " CMPA S\n");
-            } else {
-                symbol *sym = find_symbol(node->right->value, symbolList);
-                if (sym != NULL) {
-                    fprintf(mixFile, " CMPA %d\n", sym->memoryLocation);
-                } else {
-                    fprintf(stderr, "ERROR: Symbol %s was not found in symbol list.\n", node->right->value);
-                }
-            }
-            
+        default:
             break;
-        case NODE_EQ:
-            if (DEBUG) printf("NODE_EQ\n");  // For debugging
-            generate_expression(node->left);   // Evaluate left operand
+    }
+}
 
-            if (is_numeric(node->right->value)) {
-                fprintf(mixFile, " ENTX %s\n", node->right->value);
-                fprintf(mixFile, " CMPA S\n");
-            } else {
-                symbol *sym = find_symbol(node->right->value, symbolList);
-                if (sym != NULL) {
-                    fprintf(mixFile, " CMPA %d\n", sym->memoryLocation);
-                } else {
-                    fprintf(stderr, "ERROR: Symbol %s was not found in symbol list.\n", node->right->value);
-                }
-            }
+static expression_frame *push_expression(codegen_state *state, TreeNode *node, int condition) {
+    expression_frame *frame = (expression_frame *)work_stack_push(&state->expressionStack);
+    frame->node = node;
+    frame->condition = condition;
+    return frame;
+}
 
-            break;
+// order the operands of a binary node, returning the one to evaluate first
+static TreeNode *plan_operands(codegen_state *state, expression_frame *frame) {
+    TreeNode *left = frame->node->left;
+    TreeNode *right = frame->node->right;
+    int commutative = frame->node->type == NODE_ADD || frame->node->type == NODE_MULTIPLY;
+    int comparison = frame->node->type == NODE_LT || frame->node->type == NODE_EQ;
+
+    if (comparison && left->type == NODE_NUMBER && left->number == 0 && is_leaf(right)) {
+        frame->plan = PLAN_LEFT_LEAF;  // load the other side and test its sign, as in 0 < x
+        return right;
+    }
+    if (is_leaf(right)) {
+        frame->plan = PLAN_RIGHT_LEAF;
+        return left;
+    }
+    if ((commutative || comparison) && is_leaf(left)) {  // swap operands, nothing to spill (comparisons flip the jump)
+        frame->plan = PLAN_LEFT_LEAF;
+        return right;
+    }
+
+    // the right side is computed, so it has to live in memory while the left side is evaluated;
+    // for commutative operators the more demanding side goes first and the other becomes the operand
+    frame->plan = PLAN_SPILL;
+    frame->second = left;
+    if (commutative && registers_needed(state, left, 1) > registers_needed(state, right, 0)) {
+        frame->second = right;
+        return left;
+    }
+    return right;
+}
+
+// combine rA with the remaining operand, returning the jump taken when a comparison holds
+static mix_opcode finish_operator(codegen_state *state, expression_frame *frame, mix_address operand) {
+    NodeType type = frame->node->type;
+    if (type != NODE_LT && type != NODE_EQ) {
+        apply_operator(state, type, operand);
+        return MIX_JANZ;
+    }
+
+    int swapped = frame->plan == PLAN_LEFT_LEAF;  // right > left is the same test as left < right
+    if (operand.kind == MIX_ADDRESS_LITERAL && operand.value == 0 && !frame->keepIndicator) {
+        if (type == NODE_EQ) return MIX_JAZ;  // test rA itself, no compare and no literal word
+        return swapped ? MIX_JAP : MIX_JAN;
+    }
+
+    mix_ir_emit(&state->ir, MIX_CMPA, operand, -1);
+    if (type == NODE_EQ) return MIX_JE;
+    return swapped ? MIX_JG : MIX_JL;
+}
+
+// the jump taken exactly when the given one is not
+static mix_opcode invert_jump(mix_opcode jump) {
+    switch (jump) {
+        case MIX_JL: return MIX_JGE;
+        case MIX_JGE: return MIX_JL;
+        case MIX_JE: return MIX_JNE;
+        case MIX_JNE: return MIX_JE;
+        case MIX_JG: return MIX_JLE;
+        case MIX_JLE: return MIX_JG;
+        case MIX_JAN: return MIX_JANN;
+        case MIX_JANN: return MIX_JAN;
+        case MIX_JAZ: return MIX_JANZ;
+        case MIX_JANZ: return MIX_JAZ;
+        case MIX_JAP: return MIX_JANP;
+        case MIX_JANP: return MIX_JAP;
         default:
+            if (jump >= MIX_J1N && jump <= MIX_J4NP) {  // N, Z, P then NN, NZ, NP, each for rI1-rI4
+                int offset = jump - MIX_J1N;
+                int test = offset / LOOP_REGISTERS;
+                return (mix_opcode)(MIX_J1N + (test + 3) % 6 * LOOP_REGISTERS + offset % LOOP_REGISTERS);
+            }
+            return jump;
+    }
+}
+
+// a comparison of a variable held in an index register with a number, tested on the register itself;
+// returns 0 when node is some other comparison
+static int compare_register(codegen_state *state, const TreeNode *node, mix_opcode *holds) {
+    const TreeNode *variable = node->left;
+    const TreeNode *number = node->right;
+    int swapped = variable->type != NODE_ID;  // 5 < i is the same test as i > 5
+    if (swapped) {
+        variable = node->right;
+        number = node->left;
+    }
+    const induction_variable *held = held_in_register(state, variable);
+    if (held == NULL || number->type != NODE_NUMBER) return 0;
+
+    if (number->number == 0) {  // test the sign of the register, no compare and no literal word
+        if (node->type == NODE_EQ) *holds = mix_index_opcode(MIX_J1Z, held->reg);
+        else *holds = mix_index_opcode(swapped ? MIX_J1P : MIX_J1N, held->reg);
+        return 1;
+    }
+    mix_ir_emit(&state->ir, mix_index_opcode(MIX_CMP1, held->reg), mix_literal(number->number), -1);
+    if (node->type == NODE_EQ) *holds = MIX_JE;
+    else *holds = swapped ? MIX_JG : MIX_JL;
+    return 1;
+}
+
+// evaluate node into rA, or with condition set the comparison indicator and return the jump taken when it holds;
+// nested operators wait on an explicit stack so long operator chains do not deepen the C stack
+static mix_opcode generate_operands(codegen_state *state, TreeNode *node, int condition) {
+    work_stack *stack = &state->expressionStack;
+    int base = stack->count;
+    push_expression(state, node, condition);
+    mix_opcode holds = MIX_JANZ;  // jump of the most recently finished condition
+
+    while (stack->count > base) {
+        expression_frame *frame = (expression_frame *)work_stack_top(stack);
+        node = frame->node;
+        int comparison = node != NULL && (node->type == NODE_LT || node->type == NODE_EQ);
+        int binary = comparison || (node != NULL && (node->type == NODE_ADD || node->type == NODE_SUBTRACT ||
+                                                     node->type == NODE_MULTIPLY || node->type == NODE_DIVIDE));
+
+        if (node == NULL || (!binary && !is_leaf(node))) {
             if (DEBUG) printf("(default in expression)\n");  // For debugging
-            break;
+            work_stack_pop(stack);
+            continue;
+        }
+
+        if (frame->condition && !comparison) {  // plain values are true when nonzero
+            if (frame->step++ == 0) {
+                push_expression(state, node, 0);
+                continue;
+            }
+            holds = MIX_JANZ;
+            work_stack_pop(stack);
+            continue;
+        }
+
+        if (!frame->condition && comparison) {  // comparisons used as values yield 1 or 0
+            if (DEBUG && frame->step == 0) printf("NODE_COMPARISON\n");  // For debugging
+            if (frame->step++ == 0) {
+                push_expression(state, node, 1)->keepIndicator = 1;
+                continue;
+            }
+            int doneLabel = mix_ir_new_label(&state->ir, "CMP", state->compareLabelCount++);
+            mix_ir_emit(&state->ir, MIX_ENTA, mix_number(1), -1);
+            mix_ir_emit(&state->ir, holds, mix_label_address(doneLabel), -1);
+            mix_ir_emit(&state->ir, MIX_ENTA, mix_number(0), -1);
+            mix_ir_place_label(&state->ir, doneLabel);
+            work_stack_pop(stack);
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            if (DEBUG) printf("NODE_LEAF\n");  // For debugging
+            load_leaf(state, node);
+            work_stack_pop(stack);
+            continue;
+        }
+
+        switch (frame->step++) {
+            case 0: {
+                if (DEBUG) printf("NODE_BINARY\n");  // For debugging
+                if (comparison && compare_register(state, node, &holds)) {  // rA is left alone
+                    work_stack_pop(stack);
+                    break;
+                }
+                TreeNode *first = plan_operands(state, frame);
+                push_expression(state, first, 0);  // frame is stale from here on
+                break;
+            }
+            case 1:
+                if (frame->plan == PLAN_SPILL) {
+                    frame->temp = storage_temporary(state->storage, state->position, ++state->spillDepth);  // a word no live variable holds here
+                    mix_ir_emit(&state->ir, MIX_STA, mix_number(frame->temp), -1);
+                    push_expression(state, frame->second, 0);
+                    break;
+                }
+                TreeNode *leaf = frame->plan == PLAN_RIGHT_LEAF ? node->right : node->left;
+                const induction_variable *held = held_in_register(state, leaf);
+                if (held != NULL && (node->type == NODE_ADD || node->type == NODE_SUBTRACT)) {
+                    mix_ir_emit(&state->ir, node->type == NODE_ADD ? MIX_INCA : MIX_DECA, mix_indexed(0, held->reg), -1);  // rA plus or minus rIi
+                    holds = MIX_JANZ;
+                    work_stack_pop(stack);
+                    break;
+                }
+                holds = finish_operator(state, frame, leaf_operand(state, leaf));
+                work_stack_pop(stack);
+                break;
+            default:
+                holds = finish_operator(state, frame, mix_number(frame->temp));
+                state->spillDepth--;
+                work_stack_pop(stack);
+                break;
+        }
     }
+    return holds;
 }
 
+static void generate_expression(codegen_state *state, TreeNode *node) {
+    generate_operands(state, node, 0);
+}
 
+// set the comparison indicator for a condition and return the jump taken when it holds
+static mix_opcode generate_condition(codegen_state *state, TreeNode *node) {
+    return generate_operands(state, node, 1);
+}
 
-// Function to generate MIX code for a node
-void generate_mix_code(TreeNode *node) {
-    if (node == NULL) return;
+// a write of a known value: the words CHAR would leave in rA and rX come from literals
+static void write_constant(codegen_state *state, int value) {
+    int magnitude = value < 0 ? -value : value;
+    int high = 0;
+    int low = 0;
+    for (int digit = 0, scale = 1000000000; digit < 10; digit++, scale /= 10) {
+        int code = 30 + magnitude / scale % 10;  // character codes of '0'..'9' are 30..39
+        if (digit < 5) high = high * 64 + code;
+        else low = low * 64 + code;
+    }
+
+    mix_ir_emit(&state->ir, MIX_LDA, mix_literal(value < 0 ? -high : high), -1);  // the sign travels in rA
+    mix_ir_emit(&state->ir, MIX_LDX, mix_literal(low), -1);
+    mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(state->printCharsLabel), -1);
+}
 
+// Function to generate MIX code for a statement
+// moreReads tells a read that another one may follow, so it starts fetching the next record
+static void generate_statement(codegen_state *state, TreeNode *node, int moreReads) {
+    state->position++;
+    state->ir.line = node->line;
     switch (node->type) {
-        case NODE_PROGRAM:
-            createMixFile();
-            fprintf(mixFile, " ORIG 2000\n");  // First mixal command
-            generate_mix_code(node->left);  // Generate code for the program body
-            fprintf(mixFile, " END 2000\n");   // Last mixal command
-            fclose(mixFile);
-            break;
         case NODE_ASSIGNMENT:
             if (DEBUG) printf("NODE_ASSIGNMENT\n");  // For debugging
-            generate_expression(node->right);  // Generate code for the expression
+            const induction_variable *stepped = held_in_register(state, node->left);
+            if (stepped != NULL) {  // the one assignment of a loop variable in its loop, adding the step to the register
+                mix_opcode op = mix_index_opcode(stepped->step > 0 ? MIX_INC1 : MIX_DEC1, stepped->reg);
+                mix_ir_emit(&state->ir, op, mix_number(stepped->step > 0 ? stepped->step : -stepped->step), -1);
+                state->synced[stepped->reg] = 0;
+                break;
+            }
+            generate_expression(state, node->right);  // Generate code for the expression
 
-            symbol *sym = find_symbol(node->left->value, symbolList);
+            symbol *sym = find_symbol(node->left->value, state->symbols);
             if (sym == NULL) {
-                sym = create_symbol(node->left->value);  // create new symbol if not found
-                add_symbol(sym, &symbolList);  // add it to the symbol list
+                sym = create_symbol(state->symbols, node->left->value);  // create new symbol if not found
+                add_symbol(sym, state->symbols);  // add it to the symbol table
             }
 
-            fprintf(mixFile, " STA %d\n", sym->memoryLocation);  // Store result into the variable using memory address
+            sym->memoryLocation = storage_address(state->storage, sym->name);
+            mix_ir_emit(&state->ir, MIX_STA, mix_number(sym->memoryLocation), -1);  // Store result into the variable using memory address
             break;
-        case NODE_IF:
-            if (DEBUG) printf("NODE_IF\n");  // For debugging
-            int currentIfLabel = if_label_count++;
-    
-            if ((node->type == NODE_IF) && (node->right->type != NODE_ELSE)) {
-                // Generate code for the condition
-                generate_expression(node->left);
-
-                // Handle comparisons (expand as needed)
-                if (node->left->type == NODE_LT) {
-                    fprintf(mixFile, " JL THEN%d\n", currentIfLabel);
-                } else if (node->left->type == NODE_EQ) {
-                    fprintf(mixFile, " JE THEN%d\n", currentIfLabel);
-                }
-                
-                // Unconditional jump to ENDIF
-                fprintf(mixFile," JMP ENDIF%d\n", currentIfLabel);
-                
-                // THEN block
-                fprintf(mixFile, "THEN%d NOP\n", currentIfLabel);
-                generate_mix_code(node->right); // Generate code for the 'then' part
-                
-                // End of if
-                fprintf(mixFile, "ENDIF%d NOP\n", currentIfLabel);
-
-            } else if ((node->type == NODE_IF) && (node->right->type == NODE_ELSE)) {
-                // Generate code for the condition
-                generate_expression(node->left);
-
-                // Handle comparisons
-                if (node->left->type == NODE_LT) {
-                    fprintf(mixFile, " JL THEN%d\n", currentIfLabel);
-                } else if (node->left->type == NODE_EQ) {
-                    fprintf(mixFile, " JE THEN%d\n", currentIfLabel);
+        case NODE_READ:
+            if (DEBUG) printf("NODE_READ\n");  // For debugging
+            symbol *readSymbol = find_symbol(node->value, state->symbols);
+            if (readSymbol != NULL) {
+                // wait until the record in the current buffer is in, then take its first five characters
+                mix_ir_emit(&state->ir, MIX_JBUS, mix_here(), INPUT_DEVICE);
+                mix_ir_emit(&state->ir, MIX_LDX, mix_indexed(MIX_INPUT_BUFFER, INPUT_REGISTER), -1);
+
+                if (moreReads) {  // the other buffer receives the next record while the program runs on
+                    mix_ir_emit(&state->ir, MIX_ENN5, mix_indexed(-MIX_INPUT_WORDS, INPUT_REGISTER), -1);  // rI5 = 14 - rI5
+                    mix_ir_emit(&state->ir, MIX_IN, mix_indexed(MIX_INPUT_BUFFER, INPUT_REGISTER), INPUT_DEVICE);
                 }
-                
-                // Unconditional jump to ELSE
-                fprintf(mixFile, " JMP ELSE%d\n", currentIfLabel);
-                
-                // THEN block
-                fprintf(mixFile, "THEN%d NOP\n", currentIfLabel);
-                generate_mix_code(node->right->left); // Generate code for the 'then' part
-                fprintf(mixFile, " JMP ENDIF%d\n", currentIfLabel); // Jump to the end of if-else
-                
-                // ELSE block
-                fprintf(mixFile, "ELSE%d NOP\n", currentIfLabel);
-                generate_mix_code(node->right->right); // Generate code for the 'else' part
-                
-                // End of if-else
-                fprintf(mixFile, "ENDIF%d NOP\n", currentIfLabel);
+
+                mix_ir_emit(&state->ir, MIX_ENTA, mix_number(0), -1);  // NUM converts all ten characters of rAX
+                mix_ir_emit(&state->ir, MIX_NUM, mix_no_address(), -1);
+                mix_ir_emit(&state->ir, MIX_STA, mix_number(storage_address(state->storage, node->value)), -1);
+            } else {
+                fprintf(stderr, "ERROR: Symbol %s not found in symbol list.\n", node->value);
             }
             break;
-        case NODE_REPEAT:
-            if (DEBUG) printf("NODE_REPEAT\n");  // For debugging
-            int currentRepeatLabel = repeat_label_count++;
-
-            // Start of the repeat loop
-            fprintf(mixFile, "REPEAT%d NOP\n", currentRepeatLabel);
-            generate_mix_code(node->left);  // Generate code for the body of the repeat loop
-
-            generate_expression(node->right);
-            // Handle comparisons
-            if (node->right->type == NODE_LT) {
-                fprintf(mixFile, " JL ENDREPEAT%d\n", currentRepeatLabel);
-            } else if (node->right->type == NODE_EQ) {
-                fprintf(mixFile, " JE ENDREPEAT%d\n", currentRepeatLabel);
+        case NODE_WRITE:
+            if (DEBUG) printf("NODE_WRITE\n");  // For debugging
+            symbol *writeSymbol = find_symbol(node->value, state->symbols);
+
+            if (writeSymbol != NULL && node->left != NULL) {
+                write_constant(state, node->left->number);  // printed value known at compile time
+            } else if (writeSymbol != NULL && register_holding(state, node->value) != NULL) {
+                mix_ir_emit(&state->ir, MIX_ENTA, mix_indexed(0, register_holding(state, node->value)->reg), -1);  // the word may be behind
+                mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(state->printLabel), -1);
+            } else if (writeSymbol != NULL) {
+                int address = storage_address(state->storage, node->value);
+                mix_ir_emit(&state->ir, MIX_LDA, address >= 0 ? mix_number(address) : mix_literal(0), -1);  // never stored, reads as zero
+                mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(state->printLabel), -1);
             }
-
-            // Jump back to the start of the loop
-            fprintf(mixFile, " JMP REPEAT%d\n", currentRepeatLabel);
-
-            // End of the repeat loop
-            fprintf(mixFile, "ENDREPEAT%d NOP\n", currentRepeatLabel);
             break;
-        case NODE_READ:
-            if (DEBUG) printf("NODE_READ\n");  // For debugging
-            symbol *readSymbol = find_symbol(node->value, symbolList);
-            if (readSymbol != NULL) {
-                int input_buffer_address = 1000;  // Address for input
-                int input_device = 19;             // Device number for input
+        default:
+            if (DEBUG) printf("(default in generation)\n");  // For debugging
+            break;
+    }
+}
+
+// where control really goes when it enters a block: past empty blocks that only jump on,
+// unless they load or store the index registers of a loop
+static int jump_destination(const codegen_state *state, const control_flow_graph *cfg, int block) {
+    for (int hops = 0; hops < cfg->count; hops++) {  // bounded, an empty block may jump to itself
+        const basic_block *b = &cfg->blocks[block];
+        if (b->count > 0 || b->exit != EXIT_JUMP || state->preheaderOf[block] >= 0 || state->exitOf[block] >= 0) break;
+        block = b->target;
+    }
+    return block;
+}
 
-                // Read input into the buffer
-                fprintf(mixFile, " IN %d(%d)\n", input_buffer_address, input_device);
+// after a loop: the variables it kept in index registers go back to their words, those still read later at least
+static void store_loop_registers(codegen_state *state, const control_flow_graph *cfg, int block) {
+    const natural_loop *loop = &state->loops->loops[state->exitOf[block]];
+    for (int i = loop->firstInduction; i < loop->firstInduction + loop->inductionCount; i++) {
+        const induction_variable *induction = &state->loops->inductions[i];
+        if (live_in(&cfg->blocks[block], cfg_variable(cfg, induction->name))) store_register(state, induction);
+    }
+}
 
-                // Check for input errors
-                fprintf(mixFile, " JBUS *(%d)\n", input_device);
+// before a loop: its variables into their index registers, with the values they are known to have
+static void load_loop_registers(codegen_state *state, int block) {
+    const natural_loop *loop = &state->loops->loops[state->preheaderOf[block]];
+    for (int i = loop->firstInduction; i < loop->firstInduction + loop->inductionCount; i++) {
+        const induction_variable *induction = &state->loops->inductions[i];
+        mix_ir_emit(&state->ir, mix_index_opcode(MIX_ENT1, induction->reg), mix_number(induction->initial), -1);
+    }
+}
 
-                // Load the input buffer into the accumulator
-                fprintf(mixFile, " LDX %d(0:5)\n", input_buffer_address); // Load the input value
+static void emit_jump(codegen_state *state, mix_opcode op, int block) {
+    mix_ir_emit(&state->ir, op, mix_label_address(state->blockLabels[block]), -1);
+}
 
-                // Convert to numeric format if necessary
-                fprintf(mixFile, " NUM\n");
+// a block's statements and its exit, with next the block placed right after it (-1 for none);
+// the exit only jumps where control does not simply fall through into next
+static void generate_block(codegen_state *state, const control_flow_graph *cfg, int index, int next) {
+    const basic_block *block = &cfg->blocks[index];
+    if (index > 0) mix_ir_place_label(&state->ir, state->blockLabels[index]);  // on the first instruction, no landing NOP
+    state->ir.block = index;
+    state->ir.line = 0;
+    state->held = state->registers + (size_t)index * (LOOP_REGISTERS + 1);
+    memset(state->synced, 0, sizeof(state->synced));  // known only within the block
+    if (state->counters != NULL) {  // rA holds nothing between blocks
+        mix_ir_emit(&state->ir, MIX_LDA, mix_number(state->counters[index]), -1);
+        mix_ir_emit(&state->ir, MIX_INCA, mix_number(1), -1);
+        mix_ir_emit(&state->ir, MIX_STA, mix_number(state->counters[index]), -1);
+    }
+    if (state->exitOf[index] >= 0) store_loop_registers(state, cfg, index);
+    state->position++;  // block start
+    int lastRead = -1;
+    for (int i = 0; i < block->count; i++) {
+        if (block->statements[i].type == NODE_READ) lastRead = i;
+    }
+    for (int i = 0; i < block->count; i++) {
+        generate_statement(state, block->statements[i].node, i < lastRead || state->readFollows[index]);
+    }
+    if (state->preheaderOf[index] >= 0) load_loop_registers(state, index);
+
+    state->position++;  // block exit
+    state->ir.line = block->exit == EXIT_BRANCH ? block->condition->line : 0;  // the test belongs to the if or until line
+    int fallThrough = next >= 0 ? jump_destination(state, cfg, next) : -1;
+    switch (block->exit) {
+        case EXIT_JUMP: {
+            int target = jump_destination(state, cfg, block->target);
+            if (target != fallThrough) emit_jump(state, MIX_JMP, target);
+            break;
+        }
+        case EXIT_BRANCH: {
+            int target = jump_destination(state, cfg, block->target);
+            int otherwise = jump_destination(state, cfg, block->otherwise);
+            if (target == otherwise) {  // both ways lead to the same place, the condition has no effect
+                if (target != fallThrough) emit_jump(state, MIX_JMP, target);
+                break;
+            }
 
-                // Store the converted value in the variable's memory location
-                fprintf(mixFile, " STA %d(0:5)\n", readSymbol->memoryLocation);
+            mix_opcode holds = generate_condition(state, block->condition);
+            if (target == fallThrough) {
+                emit_jump(state, invert_jump(holds), otherwise);  // a loop's back edge, or the then part of an if
             } else {
-                fprintf(mixFile, "ERROR: Symbol %s not found in symbol list.\n", node->value);
+                emit_jump(state, holds, target);
+                if (otherwise != fallThrough) emit_jump(state, MIX_JMP, otherwise);
             }
             break;
-        case NODE_WRITE:
-            if (DEBUG) printf("NODE_WRITE\n");  // For debugging
-            symbol *writeSymbol = find_symbol(node->value, symbolList);
-            
-            if (writeSymbol != NULL) {
-                int current_write = write_label_count++;
+        }
+        case EXIT_HALT:
+            if (state->finishLabel < 0) {
+                mix_ir_emit(&state->ir, MIX_HLT, mix_no_address(), -1);  // Stop the machine before it runs into the data
+            } else if (next >= 0) {
+                mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(state->finishLabel), -1);  // the last line is still in its buffer
+            }  // otherwise the finishing code comes right after this block
+            break;
+    }
+}
+
+// blocks after which another read may run; a read followed by none does not fetch a record nobody uses
+static char *find_read_follows(const control_flow_graph *cfg) {
+    char *hasRead = (char *)calloc(cfg->count + 1, 1);
+    char *follows = (char *)calloc(cfg->count + 1, 1);
+    for (int b = 0; b < cfg->count; b++) {
+        const basic_block *block = &cfg->blocks[b];
+        for (int i = 0; i < block->count && !block->removed; i++) {
+            if (block->statements[i].type == NODE_READ) hasRead[b] = 1;
+        }
+    }
+
+    int changed = 1;
+    while (changed) {  // backward over the graph until no block learns anything new
+        changed = 0;
+        for (int b = cfg->count - 1; b >= 0; b--) {
+            if (cfg->blocks[b].removed || follows[b]) continue;
+            int successors[2];
+            int count = block_successors(&cfg->blocks[b], successors);
+            for (int s = 0; s < count; s++) {
+                if (hasRead[successors[s]] || follows[successors[s]]) {
+                    follows[b] = 1;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    free(hasRead);
+    return follows;
+}
 
-                fprintf(mixFile, " LDA %d(0:5)\n", writeSymbol->memoryLocation);
+// which loop variables each block finds in index registers, and the blocks that load and store them around their loops
+static void find_loop_registers(codegen_state *state, const control_flow_graph *cfg, const loop_plan *loops) {
+    state->loops = loops;
+    state->registers = (const induction_variable **)calloc((size_t)cfg->count * (LOOP_REGISTERS + 1), sizeof(induction_variable *));
+    state->preheaderOf = (int *)malloc(cfg->count * sizeof(int));
+    state->exitOf = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) state->preheaderOf[b] = state->exitOf[b] = -1;
+
+    for (int l = 0; l < loops->count; l++) {
+        const natural_loop *loop = &loops->loops[l];
+        if (loop->inductionCount == 0) continue;
+        state->preheaderOf[loop->preheader] = l;
+        for (int i = loop->firstInduction; i < loop->firstInduction + loop->inductionCount; i++) {
+            const induction_variable *induction = &loops->inductions[i];
+            for (int k = 0; k < loop->blockCount; k++) {
+                state->registers[(size_t)loop->blocks[k] * (LOOP_REGISTERS + 1) + induction->reg] = induction;
+            }
+            if (live_in(&cfg->blocks[loop->exit], cfg_variable(cfg, induction->name))) state->exitOf[loop->exit] = l;
+        }
+    }
+}
 
-                fprintf(mixFile, " CHAR\n");
+// the routine behind every write: the value goes into the next slot of the current line, and a full
+// line is printed while the other one fills, as in Knuth's buffer swapping; rJ holds the return address
+static void generate_print_routine(codegen_state *state) {
+    int second = MIX_OUTPUT_BUFFER + MIX_LINE_WORDS;
+    int end = second + MIX_LINE_WORDS;
+    int putLabel = mix_ir_new_label(&state->ir, "PUT", 0);
+    int plusLabel = mix_ir_new_label(&state->ir, "PLUS", 0);
+    int fullLabel = mix_ir_new_label(&state->ir, "FULL", 0);
+    int exitLabel = mix_ir_new_label(&state->ir, "PRINTX", 0);
+
+    mix_ir_place_label(&state->ir, state->printCharsLabel);
+    mix_ir_emit(&state->ir, MIX_STJ, mix_label_address(exitLabel), -1);
+    mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(putLabel), -1);
+    mix_ir_place_label(&state->ir, state->printLabel);
+    mix_ir_emit(&state->ir, MIX_STJ, mix_label_address(exitLabel), -1);  // return address into the exit jump
+    mix_ir_emit(&state->ir, MIX_CHAR, mix_no_address(), -1);
+
+    mix_ir_place_label(&state->ir, putLabel);
+    mix_ir_emit(&state->ir, MIX_STA, mix_indexed(1, OUTPUT_REGISTER), -1);
+    mix_ir_emit(&state->ir, MIX_STX, mix_indexed(2, OUTPUT_REGISTER), -1);
+    mix_ir_emit(&state->ir, MIX_ENTX, mix_number(44), -1);  // '+'
+    mix_ir_emit(&state->ir, MIX_JANN, mix_label_address(plusLabel), -1);
+    mix_ir_emit(&state->ir, MIX_ENTX, mix_number(45), -1);  // '-' for negative values
+    mix_ir_place_label(&state->ir, plusLabel);
+    mix_ir_emit(&state->ir, MIX_STX, mix_indexed(0, OUTPUT_REGISTER), -1);
+    mix_ir_emit(&state->ir, MIX_INC6, mix_number(SLOT_WORDS), -1);
+
+    mix_ir_emit(&state->ir, MIX_CMP6, mix_literal(second), -1);
+    mix_ir_emit(&state->ir, MIX_JE, mix_label_address(fullLabel), -1);
+    mix_ir_emit(&state->ir, MIX_CMP6, mix_literal(end), -1);
+    mix_ir_emit(&state->ir, MIX_JNE, mix_label_address(exitLabel), -1);
+    mix_ir_emit(&state->ir, MIX_OUT, mix_number(second), PRINTER_DEVICE);  // second line full, start again in the first
+    mix_ir_emit(&state->ir, MIX_ENT6, mix_number(MIX_OUTPUT_BUFFER), -1);
+    mix_ir_emit(&state->ir, MIX_JMP, mix_label_address(exitLabel), -1);
+    mix_ir_place_label(&state->ir, fullLabel);
+    mix_ir_emit(&state->ir, MIX_OUT, mix_number(MIX_OUTPUT_BUFFER), PRINTER_DEVICE);  // first line full, rI6 already points at the second
+    mix_ir_place_label(&state->ir, exitLabel);
+    mix_ir_emit(&state->ir, MIX_JMP, mix_here(), -1);
+}
 
-                fprintf(mixFile, " STA 1915(0:5)\n");
+// end of the program: blank the rest of a partly filled line, print it and halt
+static void generate_finish(codegen_state *state) {
+    int second = MIX_OUTPUT_BUFFER + MIX_LINE_WORDS;
+    int end = second + MIX_LINE_WORDS;
+    int fillFirst = mix_ir_new_label(&state->ir, "FILL", 0);
+    int fillSecond = mix_ir_new_label(&state->ir, "FILL", 1);
+    int stopLabel = mix_ir_new_label(&state->ir, "STOP", 0);
+
+    mix_ir_place_label(&state->ir, state->finishLabel);
+    mix_ir_emit(&state->ir, MIX_CMP6, mix_literal(second), -1);
+    mix_ir_emit(&state->ir, MIX_JE, mix_label_address(stopLabel), -1);  // the second line is empty
+    mix_ir_emit(&state->ir, MIX_JG, mix_label_address(fillSecond), -1);
+    mix_ir_emit(&state->ir, MIX_CMP6, mix_literal(MIX_OUTPUT_BUFFER), -1);
+    mix_ir_emit(&state->ir, MIX_JE, mix_label_address(stopLabel), -1);  // the first line is empty
+
+    int lines[2][3] = {{fillFirst, MIX_OUTPUT_BUFFER, second}, {fillSecond, second, end}};
+    for (int line = 0; line < 2; line++) {
+        mix_ir_place_label(&state->ir, lines[line][0]);
+        for (int word = 0; word < SLOT_WORDS; word++) {  // a zero word prints as five blanks
+            mix_ir_emit(&state->ir, MIX_STZ, mix_indexed(word, OUTPUT_REGISTER), -1);
+        }
+        mix_ir_emit(&state->ir, MIX_INC6, mix_number(SLOT_WORDS), -1);  // slots fill whole, so rI6 stays on a slot boundary
+        mix_ir_emit(&state->ir, MIX_CMP6, mix_literal(lines[line][2]), -1);
+        mix_ir_emit(&state->ir, MIX_JL, mix_label_address(lines[line][0]), -1);
+        mix_ir_emit(&state->ir, MIX_OUT, mix_number(lines[line][1]), PRINTER_DEVICE);
+        if (line == 0) mix_ir_emit(&state->ir, MIX_HLT, mix_no_address(), -1);
+    }
+    mix_ir_place_label(&state->ir, stopLabel);
+    mix_ir_emit(&state->ir, MIX_HLT, mix_no_address(), -1);
+}
 
-                fprintf(mixFile, " STX 1916(0:5)\n");
+static int compare_ints(const void *a, const void *b) {
+    int left = *(const int *)a;
+    int right = *(const int *)b;
+    return (left > right) - (left < right);
+}
 
-                fprintf(mixFile, " ENTX 45\n");
-                fprintf(mixFile, " JAN KPO%d\n", current_write);
-                fprintf(mixFile, " ENTX 44\n");
-                fprintf(mixFile, "KPO%d NOP\n", current_write);
+// words the assembler places after the code: one per distinct literal
+static int count_literals(const mix_ir *ir) {
+    int *values = (int *)malloc((ir->count + 1) * sizeof(int));
+    int count = 0;
+    for (int i = 0; i < ir->count; i++) {
+        if (ir->code[i].address.kind == MIX_ADDRESS_LITERAL) values[count++] = ir->code[i].address.value;
+    }
+    qsort(values, count, sizeof(int), compare_ints);
+    int distinct = 0;
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || values[i] != values[i - 1]) distinct++;
+    }
+    free(values);
+    return distinct;
+}
 
-                fprintf(mixFile, " STX 1914(0:5)\n");
+// the line map: every instruction word with its address, source line and block, then the counter of each block
+static void write_line_map(const mix_ir *ir, const control_flow_graph *cfg, const int *counters, const char *mapPath) {
+    FILE *mapFile = fopen(mapPath, "w");
+    if (mapFile == NULL) {
+        fprintf(stderr, "ERROR: Can not open line map file %s.\n", mapPath);
+        return;
+    }
+    fprintf(mapFile, "# address source-line block (line 0: code the compiler adds, block -1: I/O routines)\n");
+    int address = MIX_CODE_START;
+    for (int i = 0; i < ir->count; i++) {
+        const mix_instruction *in = &ir->code[i];
+        if (in->op != MIX_ORIG && in->op != MIX_END) fprintf(mapFile, "%d %d %d\n", address++, in->line, in->block);
+    }
+    for (int b = 0; counters != NULL && b < cfg->count; b++) {
+        if (counters[b] >= 0) fprintf(mapFile, "counter %d %d\n", b, counters[b]);  // runs of block b, --profile only
+    }
+    fclose(mapFile);
+}
 
-                fprintf(mixFile, " OUT 1914(2:3)\n");
-            }
-            break;
-        case NODE_SEQ:
-            if (DEBUG) printf("NODE_SEQ\n");  // For debugging
-            generate_mix_code(node->left);  // Generate code for the first statement
-            generate_mix_code(node->right); // Generate code for the second statement
-            break;
-        default:
-            if (DEBUG) printf("(default in generation)\n");  // For debugging
-            break;
+int generate_mix_code(const control_flow_graph *cfg, symbol_table *symbols, storage_plan *storage, const loop_plan *loops,
+                      const char *path, const char *mapPath, int profile, mix_image *image, peephole_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (cfg->count == 0) return 0;
+    if (storage->failed) {
+        if (path != NULL) remove(path);  // no stale listing from an earlier run
+        remove(mapPath);
+        return -1;
+    }
+
+    codegen_state state;
+    memset(&state, 0, sizeof(state));
+    mix_ir_init(&state.ir);
+    state.symbols = symbols;
+    state.storage = storage;
+    work_stack_init(&state.expressionStack, sizeof(expression_frame));
+    work_stack_init(&state.needStack, sizeof(need_frame));
+    state.blockLabels = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) {
+        state.blockLabels[b] = mix_ir_new_label(&state.ir, cfg->blocks[b].labelPrefix, cfg->blocks[b].labelNumber);
+    }
+    state.readFollows = find_read_follows(cfg);
+    find_loop_registers(&state, cfg, loops);
+    if (profile) {  // one counter per block, at the top of memory where nothing else goes
+        state.counters = (int *)malloc(cfg->count * sizeof(int));
+        storage->counterWords = 0;
+        for (int b = 0; b < cfg->count; b++) storage->counterWords += !cfg->blocks[b].removed;
+        for (int b = 0, next = MIX_MEMORY_SIZE - storage->counterWords; b < cfg->count; b++) {
+            state.counters[b] = cfg->blocks[b].removed ? -1 : next++;
+        }
+    }
+
+    int reads = 0;
+    int writes = 0;
+    for (int b = 0; b < cfg->count; b++) {
+        for (int i = 0; i < cfg->blocks[b].count && !cfg->blocks[b].removed; i++) {
+            reads += cfg->blocks[b].statements[i].type == NODE_READ;
+            writes += cfg->blocks[b].statements[i].type == NODE_WRITE;
+        }
     }
-}
\ No newline at end of file
+    state.printLabel = state.printCharsLabel = state.finishLabel = -1;
+    if (writes > 0) {
+        state.printLabel = mix_ir_new_label(&state.ir, "PRINT", 0);
+        state.printCharsLabel = mix_ir_new_label(&state.ir, "PRINTC", 0);
+        state.finishLabel = mix_ir_new_label(&state.ir, "FINISH", 0);
+    }
+
+    // build the whole program in memory first, blocks in source order
+    mix_ir_emit(&state.ir, MIX_ORIG, mix_number(MIX_CODE_START), -1);  // First mixal command
+    if (writes > 0) mix_ir_emit(&state.ir, MIX_ENT6, mix_number(MIX_OUTPUT_BUFFER), -1);  // first slot of the first line
+    if (reads > 0) {
+        mix_ir_emit(&state.ir, MIX_ENT5, mix_number(0), -1);
+        mix_ir_emit(&state.ir, MIX_IN, mix_number(MIX_INPUT_BUFFER), INPUT_DEVICE);  // the first record arrives while the program starts
+    }
+    for (int b = 0; b < cfg->count; b++) {
+        if (cfg->blocks[b].removed) continue;
+        int next = b + 1;
+        while (next < cfg->count && cfg->blocks[next].removed) next++;
+        generate_block(&state, cfg, b, next < cfg->count ? next : -1);
+    }
+    state.ir.line = 0;
+    state.ir.block = -1;
+    if (writes > 0) {
+        generate_finish(&state);
+        generate_print_routine(&state);
+    }
+    mix_ir_emit(&state.ir, MIX_END, mix_number(MIX_CODE_START), -1);  // Last mixal command
+    free(state.blockLabels);
+    free(state.readFollows);
+    free(state.registers);
+    free(state.preheaderOf);
+    free(state.exitOf);
+    work_stack_free(&state.expressionStack);
+    work_stack_free(&state.needStack);
+    free(state.needNodes);
+    free(state.needs);
+    optimize_peephole(&state.ir, stats);
+
+    storage->codeWords = 0;
+    for (int i = 0; i < state.ir.count; i++) {
+        if (state.ir.code[i].op != MIX_ORIG && state.ir.code[i].op != MIX_END) storage->codeWords++;
+    }
+    storage->literalWords = count_literals(&state.ir);
+    if (MIX_CODE_START + storage->codeWords + storage->literalWords + storage->counterWords > MIX_MEMORY_SIZE) {
+        fprintf(stderr, "ERROR: %d words of code, literals and counters do not fit between %d and %d.\n",
+                storage->codeWords + storage->literalWords + storage->counterWords, MIX_CODE_START, MIX_MEMORY_SIZE);
+        storage->failed = 1;
+    }
+    if (storage->failed) {  // out of memory for a spill or for the code
+        mix_ir_free(&state.ir);
+        free(state.counters);
+        if (path != NULL) remove(path);
+        remove(mapPath);
+        return -1;
+    }
+
+    int status = 0;
+    if (image != NULL) status = assemble_image(&state.ir, image);  // straight to MIX words, no text in between
+    FILE *mixFile = path != NULL ? fopen(path, "w") : NULL;
+    if (path != NULL && mixFile == NULL) {
+        fprintf(stderr, "ERROR: Can not open mixal file %s.\n", path);  // print error message if file cannot be opened
+    } else if (mixFile != NULL) {
+        mix_ir_write(&state.ir, mixFile);  // one buffered write for the whole listing
+        fclose(mixFile);
+    }
+    write_line_map(&state.ir, cfg, state.counters, mapPath);
+    mix_ir_free(&state.ir);
+    free(state.counters);
+    return status;
+}
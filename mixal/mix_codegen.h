@@ -4,6 +4,12 @@
 #include "../syntax_tree/node_types.h"
 #include "../syntax_tree/syntax_tree.h"
 #include "../symbol_table/symbol_table.h"
+#include "mix_ir.h"
+#include "mix_peephole.h"
+#include "mix_storage.h"
+#include "mix_image.h"
+#include "../optimizer/cfg.h"
+#include "../optimizer/loops.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +17,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 
-void generate_mix_code(TreeNode *node);  // generates mixal code from the ast
+int generate_mix_code(const control_flow_graph *cfg, symbol_table *symbols, storage_plan *storage, const loop_plan *loops,
+                      const char *path, const char *mapPath, int profile, mix_image *image, peephole_stats *stats);  // generates code from the basic blocks, loop variables in the index registers loops gives them, as mixal into path unless it is NULL and assembled into image unless it is NULL, with its line map in mapPath and block counters when profiling; -1 when it does not fit in MIX memory
 
 #endif
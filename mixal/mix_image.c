@@ -0,0 +1,213 @@
+#include "mix_image.h"
+
+typedef struct {
+    int address;  // instruction word waiting for its address field
+    int target;   // label id, or -1 - n for literal n
+} image_fixup;
+
+typedef struct {
+    int *values;    // distinct literal values, in order of first use
+    int count;
+    int *slots;     // open-addressing index into values, -1 marks an empty slot
+    int slotMask;
+} literal_pool;
+
+static mix_word make_word(long long value) {
+    if (value < 0) return MIX_SIGN_BIT | (mix_word)((-value) & MIX_MAGNITUDE_MASK);
+    return (mix_word)(value & MIX_MAGNITUDE_MASK);
+}
+
+// index of a literal in the pool, added on first use; the same value shares one word
+static int pool_literal(literal_pool *pool, int value) {
+    int slot = (int)(((unsigned)value * 2654435761u) >> 8) & pool->slotMask;
+    while (pool->slots[slot] >= 0) {
+        if (pool->values[pool->slots[slot]] == value) return pool->slots[slot];
+        slot = (slot + 1) & pool->slotMask;
+    }
+    pool->values[pool->count] = value;
+    pool->slots[slot] = pool->count;
+    return pool->count++;
+}
+
+static void set_address(mix_word *word, int address) {
+    *word &= ~(MIX_SIGN_BIT | (4095u << 18));  // clear sign and address bytes
+    *word |= (mix_word)(address < 0 ? -address : address) << 18;
+    if (address < 0) *word |= MIX_SIGN_BIT;
+}
+
+static int place_word(mix_image *image, int location, mix_word word) {
+    if (location < 0 || location >= MIX_MEMORY_SIZE) {
+        fprintf(stderr, "ERROR: assembled word at %d is outside MIX memory.\n", location);
+        return -1;
+    }
+    image->memory[location] = word;
+    image->loaded[location] = 1;
+    return 0;
+}
+
+int assemble_image(const mix_ir *ir, mix_image *image) {
+    memset(image, 0, sizeof(*image));
+
+    int literalUses = 0;
+    for (int i = 0; i < ir->count; i++) literalUses += ir->code[i].address.kind == MIX_ADDRESS_LITERAL;
+    literal_pool pool;
+    int slotCount = 16;
+    while (slotCount < 2 * literalUses) slotCount *= 2;
+    pool.values = (int *)malloc((literalUses + 1) * sizeof(int));
+    pool.count = 0;
+    pool.slots = (int *)malloc(slotCount * sizeof(int));
+    pool.slotMask = slotCount - 1;
+    for (int s = 0; s < slotCount; s++) pool.slots[s] = -1;
+
+    int *labelAddresses = (int *)malloc((ir->labelCount + 1) * sizeof(int));
+    for (int l = 0; l < ir->labelCount; l++) labelAddresses[l] = -1;
+    image_fixup *fixups = (image_fixup *)malloc((ir->count + 1) * sizeof(image_fixup));  // at most one per instruction
+    int fixupCount = 0;
+
+    // one pass over the code: backward references are encoded at once, the rest wait in the fixup table
+    int location = 0, status = 0, endLabel = -1;
+    for (int i = 0; i < ir->count && status == 0; i++) {
+        const mix_instruction *in = &ir->code[i];
+        if (in->op == MIX_ORIG) {
+            location = in->address.value;
+            continue;
+        }
+        if (in->op == MIX_END) {
+            image->start = in->address.value;
+            endLabel = in->label;  // placed after the literals, as MIXAL does
+            break;
+        }
+        if (in->label >= 0) labelAddresses[mix_ir_resolve_label(ir, in->label)] = location;
+
+        int address = 0;
+        switch (in->address.kind) {
+            case MIX_ADDRESS_NONE: break;
+            case MIX_ADDRESS_NUMBER: address = in->address.value; break;
+            case MIX_ADDRESS_HERE: address = location; break;
+            case MIX_ADDRESS_LITERAL:
+                fixups[fixupCount].address = location;
+                fixups[fixupCount++].target = -1 - pool_literal(&pool, in->address.value);
+                break;
+            case MIX_ADDRESS_LABEL: {
+                int label = mix_ir_resolve_label(ir, in->address.value);
+                if (labelAddresses[label] >= 0) {
+                    address = labelAddresses[label];
+                } else {
+                    fixups[fixupCount].address = location;
+                    fixups[fixupCount++].target = label;
+                }
+                break;
+            }
+        }
+        if (address < -4095 || address > 4095) {
+            fprintf(stderr, "ERROR: address %d of %s does not fit in two bytes.\n", address, mix_opcode_table[in->op].name);
+            status = -1;
+            break;
+        }
+
+        const mix_opcode_info *info = &mix_opcode_table[in->op];
+        int field = in->field >= 0 ? in->field : info->field;
+        mix_word word = ((mix_word)in->address.index << 12) | ((mix_word)field << 6) | (mix_word)info->code;
+        set_address(&word, address);
+        status = place_word(image, location++, word);
+    }
+
+    int *literalAddresses = (int *)malloc((pool.count + 1) * sizeof(int));
+    for (int n = 0; n < pool.count && status == 0; n++) {  // literals follow the code
+        literalAddresses[n] = location;
+        status = place_word(image, location++, make_word(pool.values[n]));
+    }
+    if (endLabel >= 0) labelAddresses[mix_ir_resolve_label(ir, endLabel)] = location;
+
+    for (int f = 0; f < fixupCount && status == 0; f++) {
+        int target = fixups[f].target;
+        int address = target < 0 ? literalAddresses[-1 - target] : labelAddresses[target];
+        if (address < 0) {
+            const mix_label *label = &ir->labels[target];
+            fprintf(stderr, "ERROR: label %s%d is used but never placed.\n", label->prefix, label->number);
+            status = -1;
+        } else {
+            set_address(&image->memory[fixups[f].address], address);
+        }
+    }
+
+    free(literalAddresses);
+    free(fixups);
+    free(labelAddresses);
+    free(pool.values);
+    free(pool.slots);
+    return status;
+}
+
+static void put_u32(unsigned char *bytes, uint32_t value) {  // most significant byte first
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+}
+
+int write_image_file(const mix_image *image, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Can not open image file %s.\n", path);
+        return -1;
+    }
+
+    // the whole image is built in memory first and written at once
+    unsigned char *bytes = (unsigned char *)malloc(sizeof(MIX_IMAGE_MAGIC) - 1 + 12 * MIX_MEMORY_SIZE + 8);
+    size_t length = sizeof(MIX_IMAGE_MAGIC) - 1;
+    memcpy(bytes, MIX_IMAGE_MAGIC, length);
+    for (int address = 0; address < MIX_MEMORY_SIZE;) {
+        if (!image->loaded[address]) {
+            address++;
+            continue;
+        }
+        int end = address;
+        while (end < MIX_MEMORY_SIZE && image->loaded[end]) end++;
+        put_u32(bytes + length, (uint32_t)address);
+        put_u32(bytes + length + 4, (uint32_t)(end - address));
+        length += 8;
+        for (; address < end; address++, length += 4) put_u32(bytes + length, image->memory[address]);
+    }
+    put_u32(bytes + length, (uint32_t)image->start);  // a run of no words gives the start
+    put_u32(bytes + length + 4, 0);
+    length += 8;
+
+    int failed = fwrite(bytes, 1, length, file) != length;
+    failed = fclose(file) != 0 || failed;
+    free(bytes);
+    return failed ? -1 : 0;
+}
+
+// ten decimal digits, with a minus sign punched over the last one as the loading routine expects
+static void punch_word(char *card, mix_word word) {
+    static const char *overpunched = "~JKLMNOPQR";  // MIX character codes 10-19
+    sprintf(card, "%010u", (unsigned)(word & MIX_MAGNITUDE_MASK));
+    if (word & MIX_SIGN_BIT) card[9] = overpunched[card[9] - '0'];
+}
+
+int write_card_deck(const mix_image *image, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Can not open card deck %s.\n", path);
+        return -1;
+    }
+
+    // columns 1-5 name, 6 the word count, 7-10 the first location, then up to seven words of ten columns
+    char card[81];
+    for (int address = 0; address < MIX_MEMORY_SIZE;) {
+        if (!image->loaded[address]) {
+            address++;
+            continue;
+        }
+        int count = 0;
+        while (count < MIX_CARD_WORDS && address + count < MIX_MEMORY_SIZE && image->loaded[address + count]) count++;
+        sprintf(card, "%s%d%04d", MIX_DECK_NAME, count, address);
+        for (int w = 0; w < count; w++) punch_word(card + 10 + 10 * w, image->memory[address + w]);
+        fprintf(file, "%s\n", card);
+        address += count;
+    }
+    fprintf(file, "TRANS0%04d\n", image->start);  // the transfer card starts the program
+
+    return fclose(file) != 0 ? -1 : 0;
+}
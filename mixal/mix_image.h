@@ -0,0 +1,25 @@
+#ifndef MIX_IMAGE_H
+#define MIX_IMAGE_H
+
+#include "mix_ir.h"
+#include "../simulator/mix_simulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIX_IMAGE_MAGIC "MIXIMG1\n"  // first bytes of a binary image
+#define MIX_DECK_NAME "SYDC "        // columns 1-5 of every card, which the loading routine skips
+#define MIX_CARD_WORDS 7             // words one loader card carries
+
+typedef struct {
+    mix_word memory[MIX_MEMORY_SIZE];       // contents once loaded, zero where the program puts nothing
+    unsigned char loaded[MIX_MEMORY_SIZE];  // words the program defines: its instructions and literals
+    int start;                              // address of the first instruction
+} mix_image;
+
+int assemble_image(const mix_ir *ir, mix_image *image);  // encode the instructions to MIX words, resolving labels and literals, 0 on success
+int write_image_file(const mix_image *image, const char *path);  // loaded runs as origin, count and 4-byte words, then the start, 0 on success
+int write_card_deck(const mix_image *image, const char *path);  // cards for Knuth's loading routine and a transfer card, 0 on success
+
+#endif
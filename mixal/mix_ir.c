@@ -0,0 +1,227 @@
+#include "mix_ir.h"
+
+#define A MIX_REGISTER_A
+#define X MIX_REGISTER_X
+
+// the instructions on a loop variable kept in index register i
+#define INDEX_OPCODES(i) \
+    [MIX_ENT##i] = {"ENT" #i, 0, 0, 0, 48 + i, 2}, \
+    [MIX_INC##i] = {"INC" #i, 0, 0, 0, 48 + i, 0}, \
+    [MIX_DEC##i] = {"DEC" #i, 0, 0, 0, 48 + i, 1}, \
+    [MIX_ST##i] = {"ST" #i, 0, 0, 0, 24 + i, 5}, \
+    [MIX_CMP##i] = {"CMP" #i, 0, 0, 0, 56 + i, 5}, \
+    [MIX_J##i##N] = {"J" #i "N", 0, 0, 1, 40 + i, 0}, \
+    [MIX_J##i##Z] = {"J" #i "Z", 0, 0, 1, 40 + i, 1}, \
+    [MIX_J##i##P] = {"J" #i "P", 0, 0, 1, 40 + i, 2}, \
+    [MIX_J##i##NN] = {"J" #i "NN", 0, 0, 1, 40 + i, 3}, \
+    [MIX_J##i##NZ] = {"J" #i "NZ", 0, 0, 1, 40 + i, 4}, \
+    [MIX_J##i##NP] = {"J" #i "NP", 0, 0, 1, 40 + i, 5},
+
+const mix_opcode_info mix_opcode_table[MIX_OPCODE_COUNT] = {
+    [MIX_NOP]  = {"NOP", 0, 0, 0, 0, 0},
+    [MIX_LDA]  = {"LDA", 0, A, 0, 8, 5},
+    [MIX_LDX]  = {"LDX", 0, X, 0, 15, 5},
+    [MIX_STA]  = {"STA", A, 0, 0, 24, 5},
+    [MIX_STX]  = {"STX", X, 0, 0, 31, 5},
+    [MIX_STJ]  = {"STJ", 0, 0, 0, 32, 2},
+    [MIX_STZ]  = {"STZ", 0, 0, 0, 33, 5},
+    [MIX_ENTA] = {"ENTA", 0, A, 0, 48, 2},
+    [MIX_ENTX] = {"ENTX", 0, X, 0, 55, 2},
+    [MIX_INCA] = {"INCA", A, A, 0, 48, 0},
+    [MIX_DECA] = {"DECA", A, A, 0, 48, 1},
+    [MIX_ADD]  = {"ADD", A, A, 0, 1, 5},
+    [MIX_SUB]  = {"SUB", A, A, 0, 2, 5},
+    [MIX_MUL]  = {"MUL", A, A | X, 0, 3, 5},
+    [MIX_DIV]  = {"DIV", A | X, A | X, 0, 4, 5},
+    [MIX_SLAX] = {"SLAX", A | X, A | X, 0, 6, 2},
+    [MIX_SRAX] = {"SRAX", A | X, A | X, 0, 6, 3},
+    [MIX_CMPA] = {"CMPA", A, 0, 0, 56, 5},
+    [MIX_ENT5] = {"ENT5", 0, 0, 0, 53, 2},  // index registers are not tracked: the peephole rules only follow rA and rX
+    [MIX_ENN5] = {"ENN5", 0, 0, 0, 53, 3},
+    [MIX_ENT6] = {"ENT6", 0, 0, 0, 54, 2},
+    [MIX_INC6] = {"INC6", 0, 0, 0, 54, 0},
+    [MIX_CMP6] = {"CMP6", 0, 0, 0, 62, 5},
+    INDEX_OPCODES(1)
+    INDEX_OPCODES(2)
+    INDEX_OPCODES(3)
+    INDEX_OPCODES(4)
+    [MIX_JMP]  = {"JMP", 0, 0, 1, 39, 0},
+    [MIX_JL]   = {"JL", 0, 0, 1, 39, 4},
+    [MIX_JE]   = {"JE", 0, 0, 1, 39, 5},
+    [MIX_JG]   = {"JG", 0, 0, 1, 39, 6},
+    [MIX_JGE]  = {"JGE", 0, 0, 1, 39, 7},
+    [MIX_JNE]  = {"JNE", 0, 0, 1, 39, 8},
+    [MIX_JLE]  = {"JLE", 0, 0, 1, 39, 9},
+    [MIX_JAN]  = {"JAN", A, 0, 1, 40, 0},
+    [MIX_JANZ] = {"JANZ", A, 0, 1, 40, 4},
+    [MIX_JAZ]  = {"JAZ", A, 0, 1, 40, 1},
+    [MIX_JAP]  = {"JAP", A, 0, 1, 40, 2},
+    [MIX_JANN] = {"JANN", A, 0, 1, 40, 3},
+    [MIX_JANP] = {"JANP", A, 0, 1, 40, 5},
+    [MIX_JBUS] = {"JBUS", 0, 0, 1, 34, 0},
+    [MIX_IN]   = {"IN", 0, 0, 0, 36, 0},
+    [MIX_OUT]  = {"OUT", 0, 0, 0, 37, 0},
+    [MIX_NUM]  = {"NUM", A | X, A, 0, 5, 0},
+    [MIX_CHAR] = {"CHAR", A, A | X, 0, 5, 1},
+    [MIX_HLT]  = {"HLT", 0, 0, 0, 5, 2},
+    [MIX_ORIG] = {"ORIG", 0, 0, 0, -1, -1},
+    [MIX_END]  = {"END", 0, 0, 0, -1, -1},
+};
+
+#undef A
+#undef X
+#undef INDEX_OPCODES
+
+void mix_ir_init(mix_ir *ir) {
+    memset(ir, 0, sizeof(*ir));
+    ir->pendingLabel = -1;
+    ir->block = -1;
+}
+
+int mix_ir_emit(mix_ir *ir, mix_opcode op, mix_address address, int field) {
+    if (ir->count == ir->capacity) {
+        ir->capacity = ir->capacity ? ir->capacity * 2 : 256;
+        ir->code = (mix_instruction *)realloc(ir->code, ir->capacity * sizeof(mix_instruction));
+    }
+    mix_instruction *in = &ir->code[ir->count];
+    in->op = op;
+    in->address = address;
+    in->field = field;
+    in->label = ir->pendingLabel;
+    in->line = ir->line;
+    in->block = ir->block;
+    ir->pendingLabel = -1;
+    return ir->count++;
+}
+
+int mix_ir_new_label(mix_ir *ir, const char *prefix, int number) {
+    if (ir->labelCount == ir->labelCapacity) {
+        ir->labelCapacity = ir->labelCapacity ? ir->labelCapacity * 2 : 64;
+        ir->labels = (mix_label *)realloc(ir->labels, ir->labelCapacity * sizeof(mix_label));
+    }
+    mix_label *label = &ir->labels[ir->labelCount];
+    label->prefix = prefix;
+    label->number = number;
+    label->alias = -1;
+    return ir->labelCount++;
+}
+
+void mix_ir_place_label(mix_ir *ir, int label) {
+    if (ir->pendingLabel < 0) {
+        ir->pendingLabel = label;
+    } else {
+        mix_ir_merge_label(ir, label, ir->pendingLabel);  // one instruction carries one label
+    }
+}
+
+void mix_ir_merge_label(mix_ir *ir, int label, int into) {
+    label = mix_ir_resolve_label(ir, label);
+    into = mix_ir_resolve_label(ir, into);
+    if (label != into) ir->labels[label].alias = into;
+}
+
+int mix_ir_resolve_label(const mix_ir *ir, int label) {
+    while (ir->labels[label].alias >= 0) label = ir->labels[label].alias;
+    return label;
+}
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} text_buffer;
+
+static void append(text_buffer *buffer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(text_buffer *buffer, const char *format, ...) {
+    if (buffer->capacity - buffer->length < 64) {  // no single piece is longer than this
+        buffer->capacity = buffer->capacity * 2 + 64;
+        buffer->data = (char *)realloc(buffer->data, buffer->capacity);
+    }
+    va_list args;
+    va_start(args, format);
+    buffer->length += vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+    va_end(args);
+}
+
+static void append_label(text_buffer *buffer, const mix_ir *ir, int label) {
+    const mix_label *resolved = &ir->labels[mix_ir_resolve_label(ir, label)];
+    append(buffer, "%s%d", resolved->prefix, resolved->number);
+}
+
+int mix_ir_write(const mix_ir *ir, FILE *file) {
+    text_buffer buffer = {NULL, 0, 0};
+    buffer.capacity = (size_t)ir->count * 24 + 64;  // typical line length, grown if needed
+    buffer.data = (char *)malloc(buffer.capacity);
+
+    for (int i = 0; i < ir->count; i++) {
+        const mix_instruction *in = &ir->code[i];
+        if (in->label >= 0) append_label(&buffer, ir, in->label);
+        append(&buffer, " %s", mix_opcode_table[in->op].name);
+
+        switch (in->address.kind) {
+            case MIX_ADDRESS_NONE: break;
+            case MIX_ADDRESS_NUMBER: append(&buffer, " %d", in->address.value); break;
+            case MIX_ADDRESS_LITERAL: append(&buffer, " =%d=", in->address.value); break;
+            case MIX_ADDRESS_HERE: append(&buffer, " *"); break;
+            case MIX_ADDRESS_LABEL:
+                append(&buffer, " ");
+                append_label(&buffer, ir, in->address.value);
+                break;
+        }
+        if (in->address.index > 0) append(&buffer, ",%d", in->address.index);
+
+        if (in->field >= 0) {
+            if (in->op == MIX_IN || in->op == MIX_OUT || in->op == MIX_JBUS) {
+                append(&buffer, "(%d)", in->field);  // device number
+            } else {
+                append(&buffer, "(%d:%d)", in->field / 8, in->field % 8);  // byte range
+            }
+        }
+        append(&buffer, "\n");
+    }
+
+    size_t written = fwrite(buffer.data, 1, buffer.length, file);
+    free(buffer.data);
+    return written == buffer.length ? 0 : -1;
+}
+
+void mix_ir_free(mix_ir *ir) {
+    free(ir->code);
+    free(ir->labels);
+    mix_ir_init(ir);
+}
+
+mix_opcode mix_index_opcode(mix_opcode first, int reg) {
+    return (mix_opcode)(first + reg - 1);  // each instruction has its four registers side by side
+}
+
+mix_address mix_no_address(void) {
+    mix_address address = {MIX_ADDRESS_NONE, 0};
+    return address;
+}
+
+mix_address mix_number(int value) {
+    mix_address address = {MIX_ADDRESS_NUMBER, value};
+    return address;
+}
+
+mix_address mix_indexed(int value, int index) {
+    mix_address address = {MIX_ADDRESS_NUMBER, value, index};
+    return address;
+}
+
+mix_address mix_literal(int value) {
+    mix_address address = {MIX_ADDRESS_LITERAL, value};
+    return address;
+}
+
+mix_address mix_label_address(int label) {
+    mix_address address = {MIX_ADDRESS_LABEL, label};
+    return address;
+}
+
+mix_address mix_here(void) {
+    mix_address address = {MIX_ADDRESS_HERE, 0};
+    return address;
+}
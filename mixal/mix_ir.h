@@ -0,0 +1,98 @@
+#ifndef MIX_IR_H
+#define MIX_IR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define MIX_REGISTER_A 1  // register masks used by the peephole optimizer
+#define MIX_REGISTER_X 2
+
+typedef enum {
+    MIX_NOP, MIX_LDA, MIX_LDX, MIX_STA, MIX_STX, MIX_STJ, MIX_STZ,
+    MIX_ENTA, MIX_ENTX, MIX_INCA, MIX_DECA,
+    MIX_ADD, MIX_SUB, MIX_MUL, MIX_DIV,
+    MIX_SLAX, MIX_SRAX, MIX_CMPA,
+    MIX_ENT5, MIX_ENN5, MIX_ENT6, MIX_INC6, MIX_CMP6,
+    MIX_ENT1, MIX_ENT2, MIX_ENT3, MIX_ENT4, MIX_INC1, MIX_INC2, MIX_INC3, MIX_INC4,  // rI1-rI4, for loop variables
+    MIX_DEC1, MIX_DEC2, MIX_DEC3, MIX_DEC4, MIX_ST1, MIX_ST2, MIX_ST3, MIX_ST4,
+    MIX_CMP1, MIX_CMP2, MIX_CMP3, MIX_CMP4,
+    MIX_JMP, MIX_JL, MIX_JE, MIX_JG, MIX_JGE, MIX_JNE, MIX_JLE, MIX_JAN, MIX_JANZ, MIX_JAZ, MIX_JAP, MIX_JANN, MIX_JANP, MIX_JBUS,
+    MIX_J1N, MIX_J2N, MIX_J3N, MIX_J4N, MIX_J1Z, MIX_J2Z, MIX_J3Z, MIX_J4Z, MIX_J1P, MIX_J2P, MIX_J3P, MIX_J4P,
+    MIX_J1NN, MIX_J2NN, MIX_J3NN, MIX_J4NN, MIX_J1NZ, MIX_J2NZ, MIX_J3NZ, MIX_J4NZ, MIX_J1NP, MIX_J2NP, MIX_J3NP, MIX_J4NP,
+    MIX_IN, MIX_OUT, MIX_NUM, MIX_CHAR, MIX_HLT,
+    MIX_ORIG, MIX_END,
+    MIX_OPCODE_COUNT
+} mix_opcode;
+
+typedef struct {
+    const char *name;  // mnemonic
+    int reads;         // registers whose value the instruction uses
+    int writes;        // registers it overwrites
+    int isJump;        // transfers control to its address
+    int code;          // C field of the assembled word, -1 for the ORIG and END directives
+    int field;         // F field when the instruction gives none
+} mix_opcode_info;
+
+typedef enum {
+    MIX_ADDRESS_NONE,     // no address field
+    MIX_ADDRESS_NUMBER,   // absolute address or immediate value
+    MIX_ADDRESS_LITERAL,  // =value=
+    MIX_ADDRESS_LABEL,    // code label, value is the label id
+    MIX_ADDRESS_HERE      // *, the instruction itself
+} mix_address_kind;
+
+typedef struct {
+    mix_address_kind kind;
+    int value;
+    int index;  // index register whose contents are added, 0 for none
+} mix_address;
+
+typedef struct {
+    mix_opcode op;
+    mix_address address;
+    int field;  // F-part, -1 for the default
+    int label;  // label defined at this instruction, -1 for none
+    int line;   // source line it was generated for, 0 for code the compiler adds
+    int block;  // basic block it belongs to, -1 for the shared I/O routines
+} mix_instruction;
+
+typedef struct {
+    const char *prefix;  // THEN, ENDIF, ...
+    int number;          // printed after the prefix
+    int alias;           // label this one was merged into, -1 while it stands on its own
+} mix_label;
+
+typedef struct mix_ir_tag {
+    mix_instruction *code;
+    int count;
+    int capacity;
+    mix_label *labels;
+    int labelCount;
+    int labelCapacity;
+    int pendingLabel;  // placed label waiting for the next instruction, -1 for none
+    int line;          // source line and block given to the instructions emitted from now on
+    int block;
+} mix_ir;
+
+extern const mix_opcode_info mix_opcode_table[MIX_OPCODE_COUNT];
+
+void mix_ir_init(mix_ir *ir);  // start an empty instruction list
+int mix_ir_emit(mix_ir *ir, mix_opcode op, mix_address address, int field);  // append an instruction, returns its index
+int mix_ir_new_label(mix_ir *ir, const char *prefix, int number);  // create a label named prefix+number
+void mix_ir_place_label(mix_ir *ir, int label);  // define label at the next emitted instruction
+void mix_ir_merge_label(mix_ir *ir, int label, int into);  // make every use of label refer to into
+int mix_ir_resolve_label(const mix_ir *ir, int label);  // follow merges to the label that is printed
+int mix_ir_write(const mix_ir *ir, FILE *file);  // serialize as MIXAL in one write, 0 on success
+void mix_ir_free(mix_ir *ir);  // release the instruction list
+mix_opcode mix_index_opcode(mix_opcode first, int reg);  // the form of an rI1 instruction for rI1-rI4, as MIX_INC1 and 3 give MIX_INC3
+
+mix_address mix_no_address(void);
+mix_address mix_number(int value);
+mix_address mix_indexed(int value, int index);  // value plus the contents of an index register, as in 1000,5
+mix_address mix_literal(int value);
+mix_address mix_label_address(int label);
+mix_address mix_here(void);
+
+#endif
@@ -0,0 +1,110 @@
+#include "mix_peephole.h"
+
+// hand the label of a removed instruction to the one that follows it
+static void carry_label(mix_ir *ir, int from, int to) {
+    int label = ir->code[from].label;
+    if (label < 0) return;
+
+    if (ir->code[to].label < 0) {
+        ir->code[to].label = label;
+    } else {
+        mix_ir_merge_label(ir, label, ir->code[to].label);
+    }
+}
+
+static int same_address(mix_address a, mix_address b) {
+    return a.kind == b.kind && a.value == b.value && a.index == b.index;
+}
+
+// the load at index reloads what the previous kept instruction just stored
+static int reloads_stored_value(const mix_ir *ir, int kept, int index) {
+    if (kept == 0) return 0;
+
+    const mix_instruction *store = &ir->code[kept - 1];
+    const mix_instruction *load = &ir->code[index];
+    if (load->label >= 0 || store->field != load->field) return 0;  // another path may arrive here
+    if (store->address.kind != MIX_ADDRESS_NUMBER) return 0;
+
+    return ((store->op == MIX_STA && load->op == MIX_LDA) || (store->op == MIX_STX && load->op == MIX_LDX))
+        && same_address(store->address, load->address);
+}
+
+// a load or enter whose register is overwritten before anything reads it
+static int is_dead_load(const mix_ir *ir, int index) {
+    const mix_instruction *in = &ir->code[index];
+    if (in->op != MIX_LDA && in->op != MIX_LDX && in->op != MIX_ENTA && in->op != MIX_ENTX) return 0;
+
+    int reg = mix_opcode_table[in->op].writes;
+    for (int j = index + 1; j < ir->count; j++) {
+        const mix_instruction *next = &ir->code[j];
+        const mix_opcode_info *info = &mix_opcode_table[next->op];
+
+        if (next->label >= 0) return 0;  // the register may be used along another path
+        if (info->reads & reg) return 0;
+        if (info->isJump || next->op == MIX_END || next->op == MIX_ORIG) return 0;
+        if (next->op == MIX_HLT || (info->writes & reg)) return 1;
+    }
+    return 0;
+}
+
+static int jumps_to_next(const mix_ir *ir, int index) {
+    const mix_instruction *in = &ir->code[index];
+    if (!mix_opcode_table[in->op].isJump || in->address.kind != MIX_ADDRESS_LABEL) return 0;
+    if (index + 1 >= ir->count || ir->code[index + 1].label < 0) return 0;
+
+    return mix_ir_resolve_label(ir, in->address.value) == mix_ir_resolve_label(ir, ir->code[index + 1].label);
+}
+
+// one sweep over the list, compacting it in place; returns the number of instructions removed
+static int sweep(mix_ir *ir, peephole_stats *stats) {
+    int kept = 0;
+
+    for (int i = 0; i < ir->count; i++) {
+        int hasNext = i + 1 < ir->count;
+
+        if (ir->code[i].op == MIX_NOP && hasNext) {
+            carry_label(ir, i, i + 1);
+            stats->nopLabels++;
+            continue;
+        }
+        if (hasNext && jumps_to_next(ir, i)) {
+            carry_label(ir, i, i + 1);
+            stats->jumpsToNext++;
+            continue;
+        }
+        if (reloads_stored_value(ir, kept, i)) {
+            stats->storeLoads++;
+            continue;
+        }
+        if (hasNext && is_dead_load(ir, i)) {
+            carry_label(ir, i, i + 1);
+            stats->deadLoads++;
+            continue;
+        }
+
+        ir->code[kept++] = ir->code[i];
+    }
+
+    int removed = ir->count - kept;
+    ir->count = kept;
+    return removed;
+}
+
+void optimize_peephole(mix_ir *ir, peephole_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->instructionsBefore = ir->count;
+
+    while (sweep(ir, stats) > 0) {
+        // removing an instruction can expose another match, e.g. a jump over a deleted NOP
+    }
+
+    stats->instructionsAfter = ir->count;
+}
+
+void print_peephole_stats(FILE *logFile, const peephole_stats *stats) {
+    fprintf(logFile, "Peephole: %d instructions before, %d after\n", stats->instructionsBefore, stats->instructionsAfter);
+    fprintf(logFile, "  loads after a store of the same word: %d\n", stats->storeLoads);
+    fprintf(logFile, "  register loads never used: %d\n", stats->deadLoads);
+    fprintf(logFile, "  jumps to the next instruction: %d\n", stats->jumpsToNext);
+    fprintf(logFile, "  NOP labels merged: %d\n", stats->nopLabels);
+}
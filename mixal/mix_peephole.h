@@ -0,0 +1,20 @@
+#ifndef MIX_PEEPHOLE_H
+#define MIX_PEEPHOLE_H
+
+#include "mix_ir.h"
+
+#include <stdio.h>
+
+typedef struct {
+    int instructionsBefore;  // size of the list handed to the optimizer
+    int instructionsAfter;   // size of the list written out
+    int storeLoads;          // LDA x removed right after STA x
+    int deadLoads;           // register loads overwritten before any use
+    int jumpsToNext;         // jumps to the instruction that follows anyway
+    int nopLabels;           // NOPs removed, their label moved to the next instruction
+} peephole_stats;
+
+void optimize_peephole(mix_ir *ir, peephole_stats *stats);  // apply every rule until none fires
+void print_peephole_stats(FILE *logFile, const peephole_stats *stats);  // per rule summary for the log file
+
+#endif
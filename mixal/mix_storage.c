@@ -0,0 +1,216 @@
+#include "mix_storage.h"
+
+#define DATA_CAPACITY (MIX_CODE_START - 2 * MIX_INPUT_WORDS - 2 * MIX_LINE_WORDS)  // words below the code, the I/O buffers excluded
+
+// Positions number the start of every block, each statement in it and its exit, in the order
+// generate_mix_code lays the blocks out, so the code generator can ask for spill slots by position.
+// A variable's range runs from the first to the last position where it is live, read or stored.
+
+// word index -> address, stepping over the input and output buffers
+static int data_address(int word) {
+    if (word >= MIX_INPUT_BUFFER) word += 2 * MIX_INPUT_WORDS;
+    if (word >= MIX_OUTPUT_BUFFER) word += 2 * MIX_LINE_WORDS;
+    return word;
+}
+
+static void touch(storage_plan *plan, int variable, int position) {
+    if (plan->first[variable] > position) plan->first[variable] = position;
+    if (plan->last[variable] < position) plan->last[variable] = position;
+}
+
+static void touch_uses(storage_plan *plan, const control_flow_graph *cfg, int firstUse, int useCount, int position) {
+    for (int u = firstUse; u < firstUse + useCount; u++) touch(plan, cfg->uses[u], position);
+}
+
+// positions grow with the block order, so only the first block where a variable is live sets its first
+// position and only the last sets its last one; seen masks out the variables already placed
+static void touch_set(storage_plan *plan, const control_flow_graph *cfg, const unsigned long long *set, unsigned long long *seen, int position) {
+    for (int w = 0; w < cfg->setWords; w++) {
+        unsigned long long bits = set[w] & ~seen[w];
+        seen[w] |= bits;
+        for (; bits != 0; bits &= bits - 1) touch(plan, w * 64 + __builtin_ctzll(bits), position);
+    }
+}
+
+typedef struct {
+    int first;     // start of the live range
+    int variable;
+} range_start;
+
+static int compare_start(const void *a, const void *b) {
+    const range_start *left = (const range_start *)a;
+    const range_start *right = (const range_start *)b;
+    if (left->first != right->first) return left->first - right->first;
+    return left->variable - right->variable;
+}
+
+int plan_storage(storage_plan *plan, control_flow_graph *cfg, symbol_table *symbols) {
+    memset(plan, 0, sizeof(*plan));
+    init_name_map(&plan->variables);
+    compute_liveness(cfg);
+    for (int i = 0; i < cfg->variables.count; i++) name_map_index(&plan->variables, cfg->variables.names[i]);  // same indexes as the graph
+
+    int count = plan->variables.count;
+    plan->first = (int *)malloc((count + 1) * sizeof(int));
+    plan->last = (int *)malloc((count + 1) * sizeof(int));
+    plan->words = (int *)malloc((count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        plan->first[i] = 0x7fffffff;  // untouched until the walk reaches it
+        plan->last[i] = -1;
+        plan->words[i] = -1;
+    }
+    char *stored = (char *)calloc(count + 1, 1);  // per variable: stored somewhere in the program
+
+    int *blockPositions = (int *)malloc((2 * cfg->count + 1) * sizeof(int));  // start and exit position of every block
+    for (int b = 0; b < cfg->count; b++) {
+        const basic_block *block = &cfg->blocks[b];
+        if (block->removed) continue;
+        blockPositions[2 * b] = ++plan->positions;
+        for (int i = 0; i < block->count; i++) {
+            const cfg_statement *statement = &block->statements[i];
+            int position = ++plan->positions;
+            touch_uses(plan, cfg, statement->firstUse, statement->useCount, position);  // operands are read before the result is stored
+            if (statement->target >= 0) {
+                touch(plan, statement->target, position);
+                stored[statement->target] = 1;
+            }
+        }
+        blockPositions[2 * b + 1] = ++plan->positions;
+        touch_uses(plan, cfg, block->conditionFirstUse, block->conditionUseCount, blockPositions[2 * b + 1]);
+    }
+
+    // a variable live into the entry block may be read before any store, so its range starts at position 1
+    // and it keeps a word no spill or earlier variable has written
+    unsigned long long *seen = (unsigned long long *)calloc(cfg->setWords + 1, sizeof(unsigned long long));
+    for (int b = 0; b < cfg->count; b++) {
+        if (cfg->blocks[b].removed) continue;
+        touch_set(plan, cfg, cfg->blocks[b].liveIn, seen, blockPositions[2 * b]);
+        touch_set(plan, cfg, cfg->blocks[b].liveOut, seen, blockPositions[2 * b + 1]);
+    }
+    memset(seen, 0, cfg->setWords * sizeof(unsigned long long));
+    for (int b = cfg->count - 1; b >= 0; b--) {
+        if (cfg->blocks[b].removed) continue;
+        touch_set(plan, cfg, cfg->blocks[b].liveOut, seen, blockPositions[2 * b + 1]);
+        touch_set(plan, cfg, cfg->blocks[b].liveIn, seen, blockPositions[2 * b]);
+    }
+    free(seen);
+    free(blockPositions);
+
+    // interval graphs colour optimally in order of start: each range takes the lowest word that is free again
+    range_start *ranges = (range_start *)malloc((count + 1) * sizeof(range_start));
+    int orderCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (!stored[i]) continue;  // reads of a variable that is never stored use the literal 0
+        ranges[orderCount].first = plan->first[i];
+        ranges[orderCount++].variable = i;
+    }
+    qsort(ranges, orderCount, sizeof(range_start), compare_start);
+    int *order = (int *)malloc((count + 1) * sizeof(int));
+    for (int i = 0; i < orderCount; i++) order[i] = ranges[i].variable;
+    free(ranges);
+
+    int *busyUntil = (int *)malloc((DATA_CAPACITY + 1) * sizeof(int));
+    for (int i = 0; i < orderCount && !plan->failed; i++) {
+        int variable = order[i];
+        int word = 0;
+        while (word < plan->variableWords && busyUntil[word] >= plan->first[variable]) word++;
+        if (word == plan->variableWords) {
+            if (word == DATA_CAPACITY) {
+                fprintf(stderr, "ERROR: More than %d variables are live at once, they do not fit in MIX memory.\n", DATA_CAPACITY);
+                plan->failed = 1;
+                break;
+            }
+            plan->variableWords++;
+        }
+        busyUntil[word] = plan->last[variable];
+        plan->words[variable] = word;
+    }
+
+    // index the ranges by word for the spill slot queries; within a word they are already in order
+    plan->wordStarts = (int *)calloc(plan->variableWords + 2, sizeof(int));
+    plan->intervalFirst = (int *)malloc((orderCount + 1) * sizeof(int));
+    plan->intervalLast = (int *)malloc((orderCount + 1) * sizeof(int));
+    for (int i = 0; i < orderCount; i++) {
+        if (plan->words[order[i]] >= 0) plan->wordStarts[plan->words[order[i]] + 1]++;
+    }
+    for (int w = 0; w < plan->variableWords; w++) plan->wordStarts[w + 1] += plan->wordStarts[w];
+    int *fill = (int *)malloc((plan->variableWords + 1) * sizeof(int));
+    memcpy(fill, plan->wordStarts, (plan->variableWords + 1) * sizeof(int));
+    for (int i = 0; i < orderCount; i++) {
+        int variable = order[i];
+        if (plan->words[variable] < 0) continue;
+        int at = fill[plan->words[variable]]++;
+        plan->intervalFirst[at] = plan->first[variable];
+        plan->intervalLast[at] = plan->last[variable];
+    }
+
+    for (symbol *sym = symbols->head; sym != NULL; sym = sym->next) {
+        int address = storage_address(plan, sym->name);
+        if (address >= 0) sym->memoryLocation = address;  // the symbol list shows the final layout
+    }
+
+    free(fill);
+    free(busyUntil);
+    free(order);
+    free(stored);
+    return plan->failed ? -1 : 0;
+}
+
+int storage_address(const storage_plan *plan, const char *name) {
+    int index = name_map_find(&plan->variables, name);
+    if (index < 0 || plan->words[index] < 0) return -1;
+    return data_address(plan->words[index]);
+}
+
+// some variable keeps its value in word at this position
+static int word_busy(const storage_plan *plan, int word, int position) {
+    if (word >= plan->variableWords) return 0;
+    int low = plan->wordStarts[word];
+    int high = plan->wordStarts[word + 1];
+    while (low < high) {  // last range starting at or before position
+        int middle = (low + high) / 2;
+        if (plan->intervalFirst[middle] <= position) low = middle + 1;
+        else high = middle;
+    }
+    return low > plan->wordStarts[word] && plan->intervalLast[low - 1] >= position;
+}
+
+int storage_temporary(storage_plan *plan, int position, int depth) {
+    int found = 0;
+    for (int word = 0; word < DATA_CAPACITY; word++) {
+        if (word_busy(plan, word, position) || ++found < depth) continue;
+        if (word + 1 > plan->temporaryWords) plan->temporaryWords = word + 1;
+        return data_address(word);
+    }
+    if (!plan->failed) fprintf(stderr, "ERROR: No free MIX memory word left for a spilled operand.\n");
+    plan->failed = 1;
+    return -1;
+}
+
+int storage_data_words(const storage_plan *plan) {
+    return plan->variableWords > plan->temporaryWords ? plan->variableWords : plan->temporaryWords;
+}
+
+void print_storage_report(FILE *logFile, const storage_plan *plan) {
+    int stored = 0;
+    for (int i = 0; i < plan->variables.count; i++) stored += plan->words[i] >= 0;
+    int dataWords = storage_data_words(plan);
+
+    fprintf(logFile, "\nMEMORY\n------\n");
+    fprintf(logFile, "Variables: %d in %d words, spill slots up to word %d\n", stored, plan->variableWords, plan->temporaryWords);
+    fprintf(logFile, "Data: %d words below %d, code: %d words, literals: %d words\n", dataWords, MIX_CODE_START,
+            plan->codeWords, plan->literalWords);
+    if (plan->counterWords > 0) fprintf(logFile, "Profile counters: %d words from %d\n", plan->counterWords, MIX_MEMORY_SIZE - plan->counterWords);
+    fprintf(logFile, "Peak footprint: %d of %d words\n", dataWords + plan->codeWords + plan->literalWords + plan->counterWords, MIX_MEMORY_SIZE);
+}
+
+void free_storage_plan(storage_plan *plan) {
+    free_name_map(&plan->variables);
+    free(plan->first);
+    free(plan->last);
+    free(plan->words);
+    free(plan->wordStarts);
+    free(plan->intervalFirst);
+    free(plan->intervalLast);
+    memset(plan, 0, sizeof(*plan));
+}
@@ -0,0 +1,44 @@
+#ifndef MIX_STORAGE_H
+#define MIX_STORAGE_H
+
+#include "../syntax_tree/node_types.h"
+#include "../syntax_tree/syntax_tree.h"
+#include "../symbol_table/symbol_table.h"
+#include "../optimizer/cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIX_MEMORY_SIZE 4000    // words of MIX memory
+#define MIX_CODE_START 2000     // ORIG of the generated program; variables and temporaries live below it
+#define MIX_INPUT_BUFFER 1000   // two typewriter records read by IN 1000,5(19), in turn
+#define MIX_INPUT_WORDS 14      // words in one typewriter record
+#define MIX_OUTPUT_BUFFER 1914  // two line printer records printed by OUT 1914(18) and OUT 1938(18), in turn
+#define MIX_LINE_WORDS 24       // words in one line printer record
+
+typedef struct {
+    name_map variables;  // interned name -> index into the arrays below
+    int *first;          // live range in statement positions, first..last inclusive
+    int *last;
+    int *words;          // data word of each variable, -1 when it is never stored (reads as zero)
+    int *wordStarts;     // intervals[wordStarts[w]..wordStarts[w+1]) are the ranges kept in word w
+    int *intervalFirst;  // those ranges, in position order within each word
+    int *intervalLast;
+    int positions;       // block starts, statements and block exits numbered
+    int variableWords;   // words holding variables
+    int temporaryWords;  // words up to the highest spill slot handed out
+    int codeWords;       // instructions placed from MIX_CODE_START, set by the code generator
+    int literalWords;    // literal constants placed after the code
+    int counterWords;    // --profile: one execution counter per block at the top of memory
+    int failed;          // the program does not fit in MIX memory
+} storage_plan;
+
+int plan_storage(storage_plan *plan, control_flow_graph *cfg, symbol_table *symbols);  // live ranges and packed words for every variable, 0 when they fit
+int storage_address(const storage_plan *plan, const char *name);  // address of a variable, -1 when it is never stored
+int storage_temporary(storage_plan *plan, int position, int depth);  // address of spill slot depth at a position, -1 when memory is full
+int storage_data_words(const storage_plan *plan);  // words used below MIX_CODE_START, reserved buffers excluded
+void print_storage_report(FILE *logFile, const storage_plan *plan);  // footprint summary for the log file
+void free_storage_plan(storage_plan *plan);
+
+#endif
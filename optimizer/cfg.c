@@ -0,0 +1,308 @@
+#include "cfg.h"
+
+typedef struct {
+    control_flow_graph *cfg;
+    work_stack stack;  // expression nodes still to scan
+} lowering;
+
+// point every block at its liveness sets, sized for the current blocks and variables
+static void allocate_sets(control_flow_graph *cfg) {
+    free(cfg->sets);
+    cfg->setWords = (cfg->variables.count + 63) / 64;
+    cfg->sets = (unsigned long long *)calloc((size_t)2 * cfg->count * cfg->setWords + 1, sizeof(unsigned long long));
+    for (int b = 0; b < cfg->count; b++) {
+        cfg->blocks[b].liveIn = cfg->sets + (size_t)2 * b * cfg->setWords;
+        cfg->blocks[b].liveOut = cfg->blocks[b].liveIn + cfg->setWords;
+    }
+}
+
+static int new_block(control_flow_graph *cfg, const char *labelPrefix, int labelNumber) {
+    if (cfg->count == cfg->capacity) {
+        cfg->capacity = cfg->capacity ? cfg->capacity * 2 : 64;
+        cfg->blocks = (basic_block *)realloc(cfg->blocks, cfg->capacity * sizeof(basic_block));
+    }
+    basic_block *block = &cfg->blocks[cfg->count];
+    memset(block, 0, sizeof(*block));
+    block->exit = EXIT_HALT;
+    block->target = -1;
+    block->otherwise = -1;
+    block->labelPrefix = labelPrefix;
+    block->labelNumber = labelNumber;
+    return cfg->count++;
+}
+
+static void add_use(control_flow_graph *cfg, const char *name) {
+    if (cfg->useCount == cfg->useCapacity) {
+        cfg->useCapacity = cfg->useCapacity ? cfg->useCapacity * 2 : 256;
+        cfg->uses = (int *)realloc(cfg->uses, cfg->useCapacity * sizeof(int));
+    }
+    cfg->uses[cfg->useCount++] = name_map_index(&cfg->variables, name);
+}
+
+// append every variable an expression reads to cfg->uses
+static void scan_uses(lowering *lower, TreeNode *expression) {
+    work_stack *stack = &lower->stack;
+    if (expression != NULL) *(TreeNode **)work_stack_push(stack) = expression;
+    while (stack->count > 0) {
+        TreeNode *node = *(TreeNode **)work_stack_top(stack);
+        work_stack_pop(stack);
+        if (node->type == NODE_ID) add_use(lower->cfg, node->value);
+        if (node->right != NULL) *(TreeNode **)work_stack_push(stack) = node->right;
+        if (node->left != NULL) *(TreeNode **)work_stack_push(stack) = node->left;
+    }
+}
+
+static void add_statement(lowering *lower, int index, TreeNode *node) {
+    control_flow_graph *cfg = lower->cfg;
+    basic_block *block = &cfg->blocks[index];
+    if (block->count == block->capacity) {
+        block->capacity = block->capacity ? block->capacity * 2 : 8;
+        block->statements = (cfg_statement *)realloc(block->statements, block->capacity * sizeof(cfg_statement));
+    }
+    cfg_statement *statement = &block->statements[block->count++];
+    statement->node = node;
+    statement->type = node->type;
+    statement->firstUse = cfg->useCount;
+    if (node->type == NODE_WRITE) {
+        if (node->left == NULL) add_use(cfg, node->value);  // a write given its value in left reads nothing
+    } else if (node->type == NODE_ASSIGNMENT) {
+        scan_uses(lower, node->right);  // operands are read before the result is stored
+    }
+    statement->useCount = cfg->useCount - statement->firstUse;
+    statement->target = node->type == NODE_WRITE ? -1 :
+        name_map_index(&cfg->variables, node->type == NODE_ASSIGNMENT ? node->left->value : node->value);
+}
+
+static void end_block(lowering *lower, int index, block_exit exit, TreeNode *condition, int target, int otherwise) {
+    control_flow_graph *cfg = lower->cfg;
+    int firstUse = cfg->useCount;
+    if (exit == EXIT_BRANCH) scan_uses(lower, condition);
+
+    basic_block *block = &cfg->blocks[index];
+    block->exit = exit;
+    block->condition = condition;
+    block->conditionFirstUse = firstUse;
+    block->conditionUseCount = cfg->useCount - firstUse;
+    block->target = target;
+    block->otherwise = otherwise;
+}
+
+// lower node into the graph starting in block current and return the block where control continues;
+// blocks are created in source order, which keeps the layout of the old tree walk
+static int lower_statement(lowering *lower, TreeNode *node, int current) {
+    if (node == NULL) return current;
+
+    control_flow_graph *cfg = lower->cfg;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            return lower_statement(lower, node->left, current);
+        case NODE_SEQ:
+            for (int i = 0; i < node->count; i++) {
+                current = lower_statement(lower, node->items[i], current);  // statements in order, only nested bodies recurse
+            }
+            return current;
+        case NODE_ASSIGNMENT:
+        case NODE_READ:
+        case NODE_WRITE:
+            add_statement(lower, current, node);
+            return current;
+        case NODE_IF: {
+            int number = cfg->ifCount++;
+            int hasElse = node->right != NULL && node->right->type == NODE_ELSE;
+            end_block(lower, current, EXIT_BRANCH, node->left, -1, -1);  // targets are filled in once the blocks exist
+            int thenBlock = new_block(cfg, "THEN", number);
+            int thenEnd = lower_statement(lower, hasElse ? node->right->left : node->right, thenBlock);
+            int elseBlock = -1;
+            int elseEnd = -1;
+            if (hasElse) {
+                elseBlock = new_block(cfg, "ELSE", number);
+                elseEnd = lower_statement(lower, node->right->right, elseBlock);
+            }
+            int join = new_block(cfg, "ENDIF", number);
+
+            cfg->blocks[current].target = thenBlock;
+            cfg->blocks[current].otherwise = hasElse ? elseBlock : join;
+            end_block(lower, thenEnd, EXIT_JUMP, NULL, join, -1);
+            if (hasElse) end_block(lower, elseEnd, EXIT_JUMP, NULL, join, -1);
+            return join;
+        }
+        case NODE_REPEAT: {
+            int number = cfg->repeatCount++;
+            int head = new_block(cfg, "REPEAT", number);
+            end_block(lower, current, EXIT_JUMP, NULL, head, -1);
+            int bodyEnd = lower_statement(lower, node->left, head);
+            int exitBlock = new_block(cfg, "ENDREP", number);  // labels have at most ten characters
+            end_block(lower, bodyEnd, EXIT_BRANCH, node->right, exitBlock, head);  // leave once the condition holds
+            return exitBlock;
+        }
+        default:
+            return current;
+    }
+}
+
+void build_cfg(control_flow_graph *cfg, TreeNode *root) {
+    memset(cfg, 0, sizeof(*cfg));
+    init_name_map(&cfg->variables);
+    if (root == NULL) return;  // nothing parsed, no code
+
+    lowering lower;
+    lower.cfg = cfg;
+    work_stack_init(&lower.stack, sizeof(TreeNode *));
+    int entry = new_block(cfg, "START", 0);
+    int last = lower_statement(&lower, root, entry);
+    end_block(&lower, last, EXIT_HALT, NULL, -1, -1);
+    work_stack_free(&lower.stack);
+    allocate_sets(cfg);
+}
+
+int add_block(control_flow_graph *cfg, const char *labelPrefix, int labelNumber) {
+    int index = new_block(cfg, labelPrefix, labelNumber);
+    allocate_sets(cfg);  // the blocks may have moved
+    return index;
+}
+
+void add_block_statement(control_flow_graph *cfg, int block, TreeNode *node) {
+    lowering lower;
+    lower.cfg = cfg;
+    work_stack_init(&lower.stack, sizeof(TreeNode *));
+    add_statement(&lower, block, node);
+    work_stack_free(&lower.stack);
+    if (cfg->setWords != (cfg->variables.count + 63) / 64) allocate_sets(cfg);  // a new variable needs wider sets
+}
+
+void set_block_condition(control_flow_graph *cfg, int block, TreeNode *condition) {
+    lowering lower;
+    lower.cfg = cfg;
+    work_stack_init(&lower.stack, sizeof(TreeNode *));
+    basic_block *b = &cfg->blocks[block];
+    b->condition = condition;
+    b->conditionFirstUse = cfg->useCount;
+    scan_uses(&lower, condition);
+    b->conditionUseCount = cfg->useCount - b->conditionFirstUse;
+    work_stack_free(&lower.stack);
+    if (cfg->setWords != (cfg->variables.count + 63) / 64) allocate_sets(cfg);
+}
+
+int cfg_variable(const control_flow_graph *cfg, const char *name) {
+    return name_map_find(&cfg->variables, name);
+}
+
+int live_in(const basic_block *block, int variable) {
+    return (int)((block->liveIn[variable / 64] >> (variable % 64)) & 1);
+}
+
+int live_out(const basic_block *block, int variable) {
+    return (int)((block->liveOut[variable / 64] >> (variable % 64)) & 1);
+}
+
+int block_successors(const basic_block *block, int successors[2]) {
+    int count = 0;
+    if (block->exit != EXIT_HALT) successors[count++] = block->target;
+    if (block->exit == EXIT_BRANCH) successors[count++] = block->otherwise;
+    return count;
+}
+
+void compute_liveness(control_flow_graph *cfg) {
+    if (cfg->count == 0) return;
+    int words = cfg->setWords;
+    unsigned long long *gen = (unsigned long long *)calloc((size_t)cfg->count * words + 1, sizeof(unsigned long long));  // read before any store in the block
+    unsigned long long *kill = (unsigned long long *)calloc((size_t)cfg->count * words + 1, sizeof(unsigned long long));  // stored in the block
+    memset(cfg->sets, 0, (size_t)2 * cfg->count * words * sizeof(unsigned long long));
+
+    for (int b = 0; b < cfg->count; b++) {
+        const basic_block *block = &cfg->blocks[b];
+        if (block->removed) continue;
+        unsigned long long *blockGen = gen + (size_t)b * words;
+        unsigned long long *blockKill = kill + (size_t)b * words;
+        for (int i = 0; i <= block->count; i++) {
+            int firstUse = i < block->count ? block->statements[i].firstUse : block->conditionFirstUse;
+            int useCount = i < block->count ? block->statements[i].useCount : block->conditionUseCount;
+            for (int u = firstUse; u < firstUse + useCount; u++) {
+                int variable = cfg->uses[u];
+                unsigned long long bit = 1ULL << (variable % 64);
+                if (!(blockKill[variable / 64] & bit)) blockGen[variable / 64] |= bit;
+            }
+            int target = i < block->count ? block->statements[i].target : -1;
+            if (target >= 0) blockKill[target / 64] |= 1ULL << (target % 64);
+        }
+    }
+
+    // backward problem: visiting the blocks from the end settles straight-line code in one sweep, loops in a few
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = cfg->count - 1; b >= 0; b--) {
+            basic_block *block = &cfg->blocks[b];
+            if (block->removed) continue;
+            int successors[2];
+            int successorCount = block_successors(block, successors);
+            for (int s = 0; s < successorCount; s++) {
+                const unsigned long long *in = cfg->blocks[successors[s]].liveIn;
+                for (int w = 0; w < words; w++) block->liveOut[w] |= in[w];
+            }
+            const unsigned long long *blockGen = gen + (size_t)b * words;
+            const unsigned long long *blockKill = kill + (size_t)b * words;
+            for (int w = 0; w < words; w++) {
+                unsigned long long in = blockGen[w] | (block->liveOut[w] & ~blockKill[w]);
+                if (in != block->liveIn[w]) {
+                    block->liveIn[w] = in;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    free(gen);
+    free(kill);
+}
+
+static void print_label(FILE *logFile, const control_flow_graph *cfg, int index) {
+    fprintf(logFile, "%s%d", cfg->blocks[index].labelPrefix, cfg->blocks[index].labelNumber);
+}
+
+static void print_set(FILE *logFile, const control_flow_graph *cfg, const unsigned long long *set) {
+    int any = 0;
+    for (int v = 0; v < cfg->variables.count; v++) {
+        if (!((set[v / 64] >> (v % 64)) & 1)) continue;
+        fprintf(logFile, " %s", cfg->variables.names[v]);
+        any = 1;
+    }
+    if (!any) fprintf(logFile, " -");
+}
+
+void print_cfg(FILE *logFile, const control_flow_graph *cfg) {
+    fprintf(logFile, "\nCONTROL FLOW GRAPH\n------------------\n");
+    for (int b = 0; b < cfg->count; b++) {
+        const basic_block *block = &cfg->blocks[b];
+        print_label(logFile, cfg, b);
+        if (block->removed) {
+            fprintf(logFile, ": never reached, removed\n");
+            continue;
+        }
+        fprintf(logFile, ": %d statements, ", block->count);
+        if (block->exit == EXIT_HALT) {
+            fprintf(logFile, "halt");
+        } else if (block->exit == EXIT_JUMP) {
+            fprintf(logFile, "jump to ");
+            print_label(logFile, cfg, block->target);
+        } else {
+            fprintf(logFile, "branch to ");
+            print_label(logFile, cfg, block->target);
+            fprintf(logFile, " or ");
+            print_label(logFile, cfg, block->otherwise);
+        }
+        fprintf(logFile, "\n  live in:");
+        print_set(logFile, cfg, block->liveIn);
+        fprintf(logFile, "\n  live out:");
+        print_set(logFile, cfg, block->liveOut);
+        fprintf(logFile, "\n");
+    }
+}
+
+void free_cfg(control_flow_graph *cfg) {
+    for (int b = 0; b < cfg->count; b++) free(cfg->blocks[b].statements);
+    free(cfg->blocks);
+    free(cfg->uses);
+    free(cfg->sets);
+    free_name_map(&cfg->variables);
+    memset(cfg, 0, sizeof(*cfg));
+}
@@ -0,0 +1,69 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "../syntax_tree/node_types.h"
+#include "../syntax_tree/syntax_tree.h"
+#include "../symbol_table/symbol_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    EXIT_JUMP,    // continue at target
+    EXIT_BRANCH,  // continue at target when the condition holds, at otherwise when it does not
+    EXIT_HALT     // end of the program
+} block_exit;
+
+typedef struct {
+    TreeNode *node;   // assignment, read or write; a write whose left is a number prints that number
+    NodeType type;    // node->type, so the passes over the graph need not touch the tree
+    int target;       // variable the statement stores, -1 for a write
+    int firstUse;     // cfg->uses[firstUse..firstUse + useCount) are the variables it reads
+    int useCount;
+} cfg_statement;
+
+typedef struct {
+    cfg_statement *statements;  // in order
+    int count;
+    int capacity;
+    block_exit exit;
+    TreeNode *condition;    // EXIT_BRANCH only
+    int conditionFirstUse;  // variables the condition reads, like a statement's
+    int conditionUseCount;
+    int target;
+    int otherwise;
+    const char *labelPrefix; // the label is labelPrefix followed by labelNumber, as in THEN3
+    int labelNumber;
+    int removed;            // never reached from the entry
+    unsigned long long *liveIn;   // variables whose current value may still be read, as bitsets
+    unsigned long long *liveOut;
+} basic_block;
+
+typedef struct {
+    basic_block *blocks;    // in source order, which is also the layout of the generated code; block 0 is the entry
+    int count;
+    int capacity;
+    name_map variables;     // interned name -> bit in the liveness sets
+    int *uses;              // variable indexes read by the statements and conditions, gathered while lowering
+    int useCount;
+    int useCapacity;
+    int setWords;           // 64-bit words in one liveness set
+    unsigned long long *sets;  // storage of every liveIn and liveOut
+    int ifCount;            // numbering for the labels
+    int repeatCount;
+} control_flow_graph;
+
+void build_cfg(control_flow_graph *cfg, TreeNode *root);  // lower a program into basic blocks
+int add_block(control_flow_graph *cfg, const char *labelPrefix, int labelNumber);  // empty block ending in a halt, for passes that rewrite the graph
+void add_block_statement(control_flow_graph *cfg, int block, TreeNode *node);  // append a statement to a block
+void set_block_condition(control_flow_graph *cfg, int block, TreeNode *condition);  // replace the condition of a branching block
+void compute_liveness(control_flow_graph *cfg);  // fill liveIn and liveOut of every block still in the graph
+int cfg_variable(const control_flow_graph *cfg, const char *name);  // bit of a variable, -1 when the graph never mentions it
+int live_in(const basic_block *block, int variable);
+int live_out(const basic_block *block, int variable);
+int block_successors(const basic_block *block, int successors[2]);  // blocks control may go to next, returns how many
+void print_cfg(FILE *logFile, const control_flow_graph *cfg);  // blocks, successors and live variables for the log file
+void free_cfg(control_flow_graph *cfg);
+
+#endif
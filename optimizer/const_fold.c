@@ -0,0 +1,261 @@
+#include "const_fold.h"
+
+#define MIX_WORD_LIMIT 1073741823LL  // largest magnitude a MIX word can hold (five 6-bit bytes)
+
+typedef struct {
+    char *known;  // per variable: value below is valid on every path reaching this point
+    int *values;
+} const_env;
+
+typedef struct {
+    name_map variables;  // interned name -> index into the environments
+    fold_stats *stats;
+    work_stack stack;    // nodes still to visit, shared by the walks below
+} fold_context;
+
+typedef struct {
+    TreeNode *node;
+    int visited;  // operands already folded
+} fold_frame;
+
+static void push_node(work_stack *stack, TreeNode *node) {
+    if (node != NULL) ((fold_frame *)work_stack_push(stack))->node = node;
+}
+
+// queue every statement of a sequence, or both children of any other node
+static void push_children(work_stack *stack, TreeNode *node) {
+    if (node->type == NODE_SEQ) {
+        for (int i = node->count - 1; i >= 0; i--) push_node(stack, node->items[i]);
+        return;
+    }
+    push_node(stack, node->right);
+    push_node(stack, node->left);
+}
+
+static void collect_variables(fold_context *context, TreeNode *node) {
+    int base = context->stack.count;
+    push_node(&context->stack, node);
+
+    while (context->stack.count > base) {
+        node = ((fold_frame *)work_stack_top(&context->stack))->node;
+        work_stack_pop(&context->stack);
+        if (node->type == NODE_ID || node->type == NODE_READ || node->type == NODE_WRITE) {
+            name_map_index(&context->variables, node->value);
+        }
+        push_children(&context->stack, node);
+    }
+}
+
+static const_env new_env(const fold_context *context) {
+    const_env env;
+    int count = context->variables.count;
+    env.known = (char *)calloc(count + 1, 1);  // nothing is known at the start of the program
+    env.values = (int *)calloc(count + 1, sizeof(int));
+    return env;
+}
+
+static const_env copy_env(const fold_context *context, const const_env *source) {
+    const_env env = new_env(context);
+    memcpy(env.known, source->known, context->variables.count);
+    memcpy(env.values, source->values, context->variables.count * sizeof(int));
+    return env;
+}
+
+// keep only the facts both branches agree on
+static void meet_env(const fold_context *context, const_env *into, const const_env *other) {
+    for (int i = 0; i < context->variables.count; i++) {
+        if (!other->known[i] || other->values[i] != into->values[i]) into->known[i] = 0;
+    }
+}
+
+static void free_env(const_env *env) {
+    free(env->known);
+    free(env->values);
+}
+
+// forget every variable a loop body may change, since the body runs with values from earlier iterations
+static void kill_assigned(fold_context *context, const_env *env, TreeNode *node) {
+    int base = context->stack.count;
+    push_node(&context->stack, node);
+
+    while (context->stack.count > base) {
+        node = ((fold_frame *)work_stack_top(&context->stack))->node;
+        work_stack_pop(&context->stack);
+        if (node->type == NODE_ASSIGNMENT) {
+            env->known[name_map_index(&context->variables, node->left->value)] = 0;
+            continue;  // expressions assign nothing
+        }
+        if (node->type == NODE_READ) {
+            env->known[name_map_index(&context->variables, node->value)] = 0;
+        }
+        push_children(&context->stack, node);
+    }
+}
+
+static int is_number(const TreeNode *node, int value) {
+    return node->type == NODE_NUMBER && node->number == value;
+}
+
+static void make_number(TreeNode *node, int value) {
+    node->type = NODE_NUMBER;
+    node->left = NULL;
+    node->right = NULL;
+    node->value = NULL;
+    node->number = value;
+}
+
+static void replace_with(TreeNode *node, TreeNode *operand) {
+    *node = *operand;  // operand is only referenced from here, so its fields can simply move up
+}
+
+// fold one node whose operands are already folded
+static void fold_node(fold_context *context, const_env *env, TreeNode *node) {
+    if (node->type == NODE_ID) {
+        int index = name_map_index(&context->variables, node->value);
+        if (env->known[index]) {
+            make_number(node, env->values[index]);
+            context->stats->constantsPropagated++;
+        }
+        return;
+    }
+    if (node->type == NODE_NUMBER) return;
+
+    if (node->type == NODE_LT || node->type == NODE_EQ) return;  // conditions stay comparisons for the branch code
+
+    TreeNode *left = node->left;
+    TreeNode *right = node->right;
+
+    if (left->type == NODE_NUMBER && right->type == NODE_NUMBER) {
+        long long a = left->number;
+        long long b = right->number;
+        long long result;
+
+        switch (node->type) {
+            case NODE_ADD: result = a + b; break;
+            case NODE_SUBTRACT: result = a - b; break;
+            case NODE_MULTIPLY: result = a * b; break;
+            case NODE_DIVIDE:
+                if (b == 0) return;  // leave the division for run time to report
+                result = a / b;  // truncates toward zero like MIX DIV
+                break;
+            default: return;
+        }
+        if (result > MIX_WORD_LIMIT || result < -MIX_WORD_LIMIT) return;  // would overflow rA, keep the run time behaviour
+
+        make_number(node, (int)result);
+        context->stats->expressionsFolded++;
+        return;
+    }
+
+    switch (node->type) {
+        case NODE_ADD:
+            if (is_number(right, 0)) replace_with(node, left);
+            else if (is_number(left, 0)) replace_with(node, right);
+            else return;
+            break;
+        case NODE_SUBTRACT:
+            if (is_number(right, 0)) replace_with(node, left);
+            else if (left->type == NODE_ID && right->type == NODE_ID && left->value == right->value) make_number(node, 0);
+            else return;
+            break;
+        case NODE_MULTIPLY:
+            if (is_number(right, 1)) replace_with(node, left);
+            else if (is_number(left, 1)) replace_with(node, right);
+            else if (is_number(left, 0) || is_number(right, 0)) make_number(node, 0);  // operands have no side effects
+            else return;
+            break;
+        case NODE_DIVIDE:
+            if (is_number(right, 1)) replace_with(node, left);
+            else return;
+            break;
+        default:
+            return;
+    }
+    context->stats->identitiesRemoved++;
+}
+
+// fold operands before their operator, keeping the pending operators on the work stack
+static void fold_expression(fold_context *context, const_env *env, TreeNode *node) {
+    int base = context->stack.count;
+    push_node(&context->stack, node);
+
+    while (context->stack.count > base) {
+        fold_frame *frame = (fold_frame *)work_stack_top(&context->stack);
+        node = frame->node;
+        if (frame->visited || node->type == NODE_ID || node->type == NODE_NUMBER) {
+            work_stack_pop(&context->stack);
+            fold_node(context, env, node);
+            continue;
+        }
+        frame->visited = 1;
+        push_children(&context->stack, node);  // frame is stale from here on
+    }
+}
+
+static void fold_statement(fold_context *context, const_env *env, TreeNode *node) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            fold_statement(context, env, node->left);
+            break;
+        case NODE_SEQ:
+            for (int i = 0; i < node->count; i++) {
+                fold_statement(context, env, node->items[i]);
+            }
+            break;
+        case NODE_ASSIGNMENT: {
+            fold_expression(context, env, node->right);
+            int index = name_map_index(&context->variables, node->left->value);
+            env->known[index] = node->right->type == NODE_NUMBER;
+            if (env->known[index]) env->values[index] = node->right->number;
+            break;
+        }
+        case NODE_READ:
+            env->known[name_map_index(&context->variables, node->value)] = 0;
+            break;
+        case NODE_IF: {
+            fold_expression(context, env, node->left);
+            const_env other = copy_env(context, env);  // state on the path that skips the then part
+            if (node->right->type == NODE_ELSE) {
+                fold_statement(context, env, node->right->left);
+                fold_statement(context, &other, node->right->right);
+            } else {
+                fold_statement(context, env, node->right);
+            }
+            meet_env(context, env, &other);
+            free_env(&other);
+            break;
+        }
+        case NODE_REPEAT:
+            kill_assigned(context, env, node->left);
+            fold_statement(context, env, node->left);
+            fold_expression(context, env, node->right);  // the condition sees the state at the end of the body
+            break;
+        default:
+            break;
+    }
+}
+
+void fold_constants(TreeNode *root, fold_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (root == NULL) return;
+
+    fold_context context;
+    init_name_map(&context.variables);
+    context.stats = stats;
+    work_stack_init(&context.stack, sizeof(fold_frame));
+    collect_variables(&context, root);  // fix the environment size before any copies are made
+
+    const_env env = new_env(&context);
+    fold_statement(&context, &env, root);
+    free_env(&env);
+    work_stack_free(&context.stack);
+    free_name_map(&context.variables);
+}
+
+void print_fold_stats(FILE *logFile, const fold_stats *stats) {
+    fprintf(logFile, "\nOPTIMIZATION\n------------\n");
+    fprintf(logFile, "Constant folding: %d expressions folded, %d constants propagated, %d identities removed\n",
+            stats->expressionsFolded, stats->constantsPropagated, stats->identitiesRemoved);
+}
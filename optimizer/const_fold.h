@@ -0,0 +1,21 @@
+#ifndef CONST_FOLD_H
+#define CONST_FOLD_H
+
+#include "../syntax_tree/node_types.h"
+#include "../syntax_tree/syntax_tree.h"
+#include "../symbol_table/symbol_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int expressionsFolded;    // operators replaced by their computed value
+    int constantsPropagated;  // variable uses replaced by a known constant
+    int identitiesRemoved;    // x + 0, x * 1, x - x and friends simplified
+} fold_stats;
+
+void fold_constants(TreeNode *root, fold_stats *stats);  // rewrite the tree in place before code generation
+void print_fold_stats(FILE *logFile, const fold_stats *stats);  // summary for the log file
+
+#endif
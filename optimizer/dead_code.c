@@ -0,0 +1,143 @@
+#include "dead_code.h"
+
+static int is_set(const unsigned long long *set, int variable) {
+    return (int)((set[variable / 64] >> (variable % 64)) & 1);
+}
+
+static void set_uses(unsigned long long *live, const control_flow_graph *cfg, int firstUse, int useCount) {
+    for (int u = firstUse; u < firstUse + useCount; u++) {
+        live[cfg->uses[u] / 64] |= 1ULL << (cfg->uses[u] % 64);
+    }
+}
+
+// walk a block backward from the variables live after it, flagging the assignments nobody reads when dead is given;
+// such an assignment reads nothing either, so a chain of stores feeding only dead stores dies in one pass (strong liveness)
+static void transfer_block(const control_flow_graph *cfg, const basic_block *block, unsigned long long *live, char *dead) {
+    set_uses(live, cfg, block->conditionFirstUse, block->conditionUseCount);
+    for (int i = block->count - 1; i >= 0; i--) {
+        const cfg_statement *statement = &block->statements[i];
+        if (statement->target >= 0) {
+            if (statement->type == NODE_ASSIGNMENT && !is_set(live, statement->target)) {
+                if (dead != NULL) dead[i] = 1;
+                continue;
+            }
+            live[statement->target / 64] &= ~(1ULL << (statement->target % 64));  // reads stay: they consume a record whether or not the value is used
+        }
+        set_uses(live, cfg, statement->firstUse, statement->useCount);
+    }
+}
+
+// value of a condition folding left as plain numbers, 0 when it depends on a variable
+static int constant_condition(const TreeNode *condition, int *holds) {
+    if (condition->type == NODE_NUMBER) {
+        *holds = condition->number != 0;
+        return 1;
+    }
+    if ((condition->type == NODE_LT || condition->type == NODE_EQ) &&
+        condition->left->type == NODE_NUMBER && condition->right->type == NODE_NUMBER) {
+        int left = condition->left->number;
+        int right = condition->right->number;
+        *holds = condition->type == NODE_LT ? left < right : left == right;
+        return 1;
+    }
+    return 0;
+}
+
+static void fold_branches(control_flow_graph *cfg, dead_code_stats *stats) {
+    for (int b = 0; b < cfg->count; b++) {
+        basic_block *block = &cfg->blocks[b];
+        int holds;
+        if (block->exit != EXIT_BRANCH || !constant_condition(block->condition, &holds)) continue;
+        block->exit = EXIT_JUMP;
+        if (!holds) block->target = block->otherwise;
+        block->otherwise = -1;
+        block->condition = NULL;
+        block->conditionUseCount = 0;
+        stats->branchesFolded++;
+    }
+}
+
+static void remove_unreachable(control_flow_graph *cfg, dead_code_stats *stats) {
+    char *reached = (char *)calloc(cfg->count + 1, 1);
+    work_stack stack;
+    work_stack_init(&stack, sizeof(int));
+    *(int *)work_stack_push(&stack) = 0;
+    reached[0] = 1;
+    while (stack.count > 0) {
+        int successors[2];
+        int successorCount = block_successors(&cfg->blocks[*(int *)work_stack_top(&stack)], successors);
+        work_stack_pop(&stack);
+        for (int s = 0; s < successorCount; s++) {
+            if (reached[successors[s]]) continue;
+            reached[successors[s]] = 1;
+            *(int *)work_stack_push(&stack) = successors[s];
+        }
+    }
+    for (int b = 0; b < cfg->count; b++) {
+        if (reached[b] || cfg->blocks[b].removed) continue;
+        cfg->blocks[b].removed = 1;
+        stats->blocksRemoved++;
+    }
+    work_stack_free(&stack);
+    free(reached);
+}
+
+void eliminate_dead_code(control_flow_graph *cfg, dead_code_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (cfg->count == 0) return;
+    fold_branches(cfg, stats);
+    remove_unreachable(cfg, stats);
+
+    int words = cfg->setWords;
+    unsigned long long *live = (unsigned long long *)calloc(words + 1, sizeof(unsigned long long));
+    memset(cfg->sets, 0, (size_t)2 * cfg->count * words * sizeof(unsigned long long));
+
+    // liveness where only the operands of live assignments count, settled like compute_liveness
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = cfg->count - 1; b >= 0; b--) {
+            basic_block *block = &cfg->blocks[b];
+            if (block->removed) continue;
+            int successors[2];
+            int successorCount = block_successors(block, successors);
+            for (int s = 0; s < successorCount; s++) {
+                const unsigned long long *in = cfg->blocks[successors[s]].liveIn;
+                for (int w = 0; w < words; w++) block->liveOut[w] |= in[w];
+            }
+            memcpy(live, block->liveOut, words * sizeof(unsigned long long));
+            transfer_block(cfg, block, live, NULL);
+            if (memcmp(live, block->liveIn, words * sizeof(unsigned long long)) != 0) {
+                memcpy(block->liveIn, live, words * sizeof(unsigned long long));
+                changed = 1;
+            }
+        }
+    }
+
+    char *dead = NULL;
+    for (int b = 0; b < cfg->count; b++) {
+        basic_block *block = &cfg->blocks[b];
+        if (block->removed) continue;
+        dead = (char *)realloc(dead, block->count + 1);
+        memset(dead, 0, block->count + 1);
+        memcpy(live, block->liveOut, words * sizeof(unsigned long long));
+        transfer_block(cfg, block, live, dead);
+        int kept = 0;
+        for (int i = 0; i < block->count; i++) {
+            if (dead[i]) {
+                stats->storesRemoved++;
+            } else {
+                block->statements[kept++] = block->statements[i];
+            }
+        }
+        block->count = kept;
+    }
+
+    free(dead);
+    free(live);
+}
+
+void print_dead_code_stats(FILE *logFile, const dead_code_stats *stats) {
+    fprintf(logFile, "Dead code: %d stores and %d blocks removed, %d branches folded\n",
+            stats->storesRemoved, stats->blocksRemoved, stats->branchesFolded);
+}
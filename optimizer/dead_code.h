@@ -0,0 +1,19 @@
+#ifndef DEAD_CODE_H
+#define DEAD_CODE_H
+
+#include "cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int storesRemoved;   // assignments whose value is never read
+    int blocksRemoved;   // blocks no path from the entry reaches
+    int branchesFolded;  // conditions known at compile time turned into jumps
+} dead_code_stats;
+
+void eliminate_dead_code(control_flow_graph *cfg, dead_code_stats *stats);  // rewrite the graph in place
+void print_dead_code_stats(FILE *logFile, const dead_code_stats *stats);  // summary for the log file
+
+#endif
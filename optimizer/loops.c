@@ -0,0 +1,723 @@
+#include "loops.h"
+
+#include <stdint.h>
+
+#define INDEX_LIMIT 4095  // largest magnitude an index register holds; the machine stops on anything beyond
+
+typedef struct {
+    int block;
+    int next;  // successors visited so far
+} dfs_frame;
+
+typedef struct {
+    TreeNode *node;
+    int step;            // operands visited so far
+    TreeNode *left;      // rewritten left operand
+    int leftInvariant;   // no iteration changes its value
+    unsigned leftHash;
+} hoist_frame;
+
+typedef struct {
+    const TreeNode *first;
+    const TreeNode *second;
+} node_pair;
+
+typedef struct {
+    control_flow_graph *cfg;
+    arena *nodes;
+    name_pool *names;
+    loop_plan *plan;
+
+    int *predStart;    // predecessors of block b are preds[predStart[b]..predStart[b + 1])
+    int *preds;
+    int *order;        // blocks the entry reaches, in reverse postorder
+    int orderCount;
+    int *rank;         // position of a block in order, -1 when the entry never reaches it
+    int *idom;         // immediate dominator, the entry being its own
+    int *enter;        // dominator tree numbering: a dominates b when b's numbers lie within a's
+    int *leave;
+    int *innermost;    // innermost loop holding each block, -1 outside every loop
+    int *blockMark;    // stamp of the last pass that marked a block
+    int blockStamp;
+
+    int *variableMark; // stamp of the loop whose assignments were last counted
+    int *assignments;  // assignments to each variable in that loop
+    const cfg_statement **assignment;  // the last of them
+    int *assignedBlock;
+    int variableCapacity;
+    int variableStamp;
+
+    unsigned *hashes;  // expressions hoisted out of the current loop and the temporaries holding them
+    TreeNode **hoisted;
+    const char **temps;
+    int *slotOf;       // hash slot of each; a slot counts only if slotOf points back at it
+    int hoistCount;
+    int hoistCapacity;
+    int *slots;
+    int slotCapacity;
+    int tempCount;
+
+    work_stack stack;
+    work_stack pairs;
+    TreeNode **statements;  // a block being rebuilt
+    int statementCapacity;
+} loop_analysis;
+
+static int is_leaf(const TreeNode *node) {
+    return node->type == NODE_NUMBER || node->type == NODE_ID;
+}
+
+static int is_arithmetic(NodeType type) {
+    return type == NODE_ADD || type == NODE_SUBTRACT || type == NODE_MULTIPLY || type == NODE_DIVIDE;
+}
+
+// successors of a block, a branch going the same way on both outcomes counted once
+static int successors_of(const basic_block *block, int successors[2]) {
+    int count = block_successors(block, successors);
+    if (count == 2 && successors[0] == successors[1]) count = 1;
+    return count;
+}
+
+static int predecessor_count(const loop_analysis *a, int block) {
+    return a->predStart[block + 1] - a->predStart[block];
+}
+
+static void find_predecessors(loop_analysis *a) {
+    control_flow_graph *cfg = a->cfg;
+    a->predStart = (int *)calloc(cfg->count + 1, sizeof(int));
+    int successors[2];
+    for (int b = 0; b < cfg->count; b++) {
+        if (cfg->blocks[b].removed) continue;
+        int count = successors_of(&cfg->blocks[b], successors);
+        for (int s = 0; s < count; s++) a->predStart[successors[s] + 1]++;
+    }
+    for (int b = 0; b < cfg->count; b++) a->predStart[b + 1] += a->predStart[b];
+
+    a->preds = (int *)malloc((a->predStart[cfg->count] + 1) * sizeof(int));
+    int *fill = (int *)malloc((cfg->count + 1) * sizeof(int));
+    memcpy(fill, a->predStart, cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) {
+        if (cfg->blocks[b].removed) continue;
+        int count = successors_of(&cfg->blocks[b], successors);
+        for (int s = 0; s < count; s++) a->preds[fill[successors[s]]++] = b;
+    }
+    free(fill);
+}
+
+// reverse postorder from the entry, depth first on an explicit stack
+static void order_blocks(loop_analysis *a) {
+    control_flow_graph *cfg = a->cfg;
+    a->order = (int *)malloc(cfg->count * sizeof(int));
+    a->rank = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) a->rank[b] = -1;
+
+    work_stack stack;
+    work_stack_init(&stack, sizeof(dfs_frame));
+    ((dfs_frame *)work_stack_push(&stack))->block = 0;
+    a->rank[0] = -2;  // on the stack or done
+    while (stack.count > 0) {
+        dfs_frame *frame = (dfs_frame *)work_stack_top(&stack);
+        int successors[2];
+        int count = successors_of(&cfg->blocks[frame->block], successors);
+        if (frame->next < count) {
+            int successor = successors[frame->next++];
+            if (a->rank[successor] == -1) {
+                a->rank[successor] = -2;
+                ((dfs_frame *)work_stack_push(&stack))->block = successor;  // frame is stale from here on
+            }
+            continue;
+        }
+        a->order[a->orderCount++] = frame->block;
+        work_stack_pop(&stack);
+    }
+    work_stack_free(&stack);
+
+    for (int i = 0, j = a->orderCount - 1; i < j; i++, j--) {
+        int swap = a->order[i];
+        a->order[i] = a->order[j];
+        a->order[j] = swap;
+    }
+    for (int i = 0; i < a->orderCount; i++) a->rank[a->order[i]] = i;
+}
+
+static int intersect(const loop_analysis *a, int first, int second) {
+    while (first != second) {
+        while (a->rank[first] > a->rank[second]) first = a->idom[first];
+        while (a->rank[second] > a->rank[first]) second = a->idom[second];
+    }
+    return first;
+}
+
+// immediate dominators by the iteration of Cooper, Harvey and Kennedy, then the dominator tree numbered
+// so that each dominance question is two comparisons
+static void find_dominators(loop_analysis *a) {
+    control_flow_graph *cfg = a->cfg;
+    a->idom = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) a->idom[b] = -1;
+    a->idom[0] = 0;
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (int i = 1; i < a->orderCount; i++) {
+            int b = a->order[i];
+            int best = -1;
+            for (int p = a->predStart[b]; p < a->predStart[b + 1]; p++) {
+                int pred = a->preds[p];
+                if (a->idom[pred] < 0) continue;  // not reached yet, or never
+                best = best < 0 ? pred : intersect(a, pred, best);
+            }
+            if (best != a->idom[b]) {
+                a->idom[b] = best;
+                changed = 1;
+            }
+        }
+    }
+
+    int *childStart = (int *)calloc(cfg->count + 1, sizeof(int));
+    int *children = (int *)malloc((a->orderCount + 1) * sizeof(int));
+    for (int i = 1; i < a->orderCount; i++) childStart[a->idom[a->order[i]] + 1]++;
+    for (int b = 0; b < cfg->count; b++) childStart[b + 1] += childStart[b];
+    int *fill = (int *)malloc((cfg->count + 1) * sizeof(int));
+    memcpy(fill, childStart, cfg->count * sizeof(int));
+    for (int i = 1; i < a->orderCount; i++) children[fill[a->idom[a->order[i]]]++] = a->order[i];
+    free(fill);
+
+    a->enter = (int *)malloc(cfg->count * sizeof(int));
+    a->leave = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) a->enter[b] = a->leave[b] = -1;
+    work_stack stack;
+    work_stack_init(&stack, sizeof(dfs_frame));
+    int clock = 0;
+    ((dfs_frame *)work_stack_push(&stack))->block = 0;
+    a->enter[0] = clock++;
+    while (stack.count > 0) {
+        dfs_frame *frame = (dfs_frame *)work_stack_top(&stack);
+        int b = frame->block;
+        if (childStart[b] + frame->next < childStart[b + 1]) {
+            int child = children[childStart[b] + frame->next++];
+            a->enter[child] = clock++;
+            ((dfs_frame *)work_stack_push(&stack))->block = child;  // frame is stale from here on
+            continue;
+        }
+        a->leave[b] = clock++;
+        work_stack_pop(&stack);
+    }
+    work_stack_free(&stack);
+    free(childStart);
+    free(children);
+}
+
+static int dominates(const loop_analysis *a, int dominator, int block) {
+    if (a->enter[dominator] < 0 || a->enter[block] < 0) return 0;
+    return a->enter[dominator] <= a->enter[block] && a->leave[block] <= a->leave[dominator];
+}
+
+// the natural loop of the back edge from latch to head, kept when it has the shape of a lowered repeat:
+// entered through one preheader that jumps to the head, left only by the latch's until test into an exit of its own
+static void add_loop(loop_analysis *a, int head, int latch) {
+    control_flow_graph *cfg = a->cfg;
+    const basic_block *latchBlock = &cfg->blocks[latch];
+    if (latchBlock->exit != EXIT_BRANCH || latchBlock->otherwise != head || latchBlock->target == head) return;
+
+    int stamp = ++a->blockStamp;
+    int capacity = 16;
+    int *blocks = (int *)malloc(capacity * sizeof(int));
+    int count = 0;
+    blocks[count++] = head;
+    a->blockMark[head] = stamp;
+    if (latch != head) {
+        blocks[count++] = latch;
+        a->blockMark[latch] = stamp;
+    }
+    for (int i = 1; i < count; i++) {  // backward from the latch; every path reaches the head, which dominates it
+        for (int p = a->predStart[blocks[i]]; p < a->predStart[blocks[i] + 1]; p++) {
+            int pred = a->preds[p];
+            if (a->blockMark[pred] == stamp || a->rank[pred] < 0) continue;
+            if (count == capacity) {
+                capacity *= 2;
+                blocks = (int *)realloc(blocks, capacity * sizeof(int));
+            }
+            blocks[count++] = pred;
+            a->blockMark[pred] = stamp;
+        }
+    }
+
+    int exit = latchBlock->target;
+    int valid = a->blockMark[exit] != stamp && predecessor_count(a, exit) == 1;
+    for (int i = 0; i < count && valid; i++) {
+        int successors[2];
+        int successorCount = successors_of(&cfg->blocks[blocks[i]], successors);
+        for (int s = 0; s < successorCount; s++) {
+            if (a->blockMark[successors[s]] != stamp && blocks[i] != latch) valid = 0;
+        }
+    }
+    int preheader = -1;
+    for (int p = a->predStart[head]; p < a->predStart[head + 1] && valid; p++) {
+        if (a->blockMark[a->preds[p]] == stamp) continue;
+        if (preheader >= 0) valid = 0;
+        preheader = a->preds[p];
+    }
+    if (!valid || preheader < 0 || cfg->blocks[preheader].exit != EXIT_JUMP) {
+        free(blocks);
+        return;
+    }
+
+    loop_plan *plan = a->plan;
+    plan->loops = (natural_loop *)realloc(plan->loops, (plan->count + 1) * sizeof(natural_loop));
+    natural_loop *loop = &plan->loops[plan->count++];
+    memset(loop, 0, sizeof(*loop));
+    loop->head = head;
+    loop->latch = latch;
+    loop->preheader = preheader;
+    loop->exit = exit;
+    loop->blocks = blocks;
+    loop->blockCount = count;
+}
+
+static int compare_loops(const void *first, const void *second) {
+    const natural_loop *left = (const natural_loop *)first;
+    const natural_loop *right = (const natural_loop *)second;
+    if (left->blockCount != right->blockCount) return right->blockCount - left->blockCount;  // outer loops first
+    return left->head - right->head;
+}
+
+static void find_loops(loop_analysis *a) {
+    control_flow_graph *cfg = a->cfg;
+    int *backEdges = (int *)calloc(cfg->count, sizeof(int));
+    int *latchOf = (int *)malloc(cfg->count * sizeof(int));
+    for (int i = 0; i < a->orderCount; i++) {
+        int b = a->order[i];
+        int successors[2];
+        int count = successors_of(&cfg->blocks[b], successors);
+        for (int s = 0; s < count; s++) {
+            if (!dominates(a, successors[s], b)) continue;
+            backEdges[successors[s]]++;
+            latchOf[successors[s]] = b;
+        }
+    }
+    for (int i = 0; i < a->orderCount; i++) {
+        int head = a->order[i];
+        if (backEdges[head] == 1) add_loop(a, head, latchOf[head]);  // a repeat has a single until test
+    }
+    free(backEdges);
+    free(latchOf);
+
+    loop_plan *plan = a->plan;
+    if (plan->count > 1) qsort(plan->loops, plan->count, sizeof(natural_loop), compare_loops);
+    a->innermost = (int *)malloc(cfg->count * sizeof(int));
+    for (int b = 0; b < cfg->count; b++) a->innermost[b] = -1;
+    for (int l = 0; l < plan->count; l++) {  // natural loops with different heads nest or are disjoint
+        natural_loop *loop = &plan->loops[l];
+        loop->parent = a->innermost[loop->head];
+        for (int i = 0; i < loop->blockCount; i++) a->innermost[loop->blocks[i]] = l;
+    }
+}
+
+// mark the blocks that run in every iteration: those dominating the latch; returns the stamp they carry
+static int mark_every_iteration(loop_analysis *a, const natural_loop *loop) {
+    int stamp = ++a->blockStamp;
+    for (int b = loop->latch;; b = a->idom[b]) {
+        a->blockMark[b] = stamp;
+        if (b == loop->head) break;
+    }
+    return stamp;
+}
+
+static void count_assignments(loop_analysis *a, const natural_loop *loop) {
+    control_flow_graph *cfg = a->cfg;
+    if (cfg->variables.count > a->variableCapacity) {
+        int old = a->variableCapacity;
+        a->variableCapacity = cfg->variables.count * 2;
+        a->variableMark = (int *)realloc(a->variableMark, a->variableCapacity * sizeof(int));
+        a->assignments = (int *)realloc(a->assignments, a->variableCapacity * sizeof(int));
+        a->assignment = (const cfg_statement **)realloc(a->assignment, a->variableCapacity * sizeof(cfg_statement *));
+        a->assignedBlock = (int *)realloc(a->assignedBlock, a->variableCapacity * sizeof(int));
+        for (int v = old; v < a->variableCapacity; v++) a->variableMark[v] = 0;
+    }
+
+    int stamp = ++a->variableStamp;
+    for (int i = 0; i < loop->blockCount; i++) {
+        const basic_block *block = &cfg->blocks[loop->blocks[i]];
+        for (int s = 0; s < block->count; s++) {
+            int target = block->statements[s].target;
+            if (target < 0) continue;
+            if (a->variableMark[target] != stamp) {
+                a->variableMark[target] = stamp;
+                a->assignments[target] = 0;
+            }
+            a->assignments[target]++;
+            a->assignment[target] = &block->statements[s];
+            a->assignedBlock[target] = loop->blocks[i];
+        }
+    }
+}
+
+static int assigned_in_loop(const loop_analysis *a, const char *name) {
+    int variable = cfg_variable(a->cfg, name);
+    return variable >= 0 && variable < a->variableCapacity && a->variableMark[variable] == a->variableStamp;
+}
+
+static unsigned node_hash(NodeType type, unsigned left, unsigned right) {
+    unsigned hash = (unsigned)type * 2654435761u;
+    hash = (hash ^ left) * 2246822519u;
+    hash = (hash ^ right) * 3266489917u;
+    return hash ^ (hash >> 15);
+}
+
+static unsigned leaf_hash(const TreeNode *node) {
+    if (node->type == NODE_ID) return node_hash(NODE_ID, (unsigned)((uintptr_t)node->value >> 3), 0);
+    return node_hash(node->type, (unsigned)node->number, 0);
+}
+
+// the two expressions compute the same thing the same way
+static int same_expression(loop_analysis *a, const TreeNode *first, const TreeNode *second) {
+    work_stack *pairs = &a->pairs;
+    node_pair *pair = (node_pair *)work_stack_push(pairs);
+    pair->first = first;
+    pair->second = second;
+    int same = 1;
+    while (pairs->count > 0) {
+        node_pair top = *(node_pair *)work_stack_top(pairs);
+        work_stack_pop(pairs);
+        if (!same || top.first == top.second) continue;  // after a difference the stack only drains
+        if (top.first->type != top.second->type || is_leaf(top.first) != is_leaf(top.second)) {
+            same = 0;
+        } else if (top.first->type == NODE_ID) {
+            same = top.first->value == top.second->value;
+        } else if (top.first->type == NODE_NUMBER) {
+            same = top.first->number == top.second->number;
+        } else {
+            pair = (node_pair *)work_stack_push(pairs);
+            pair->first = top.first->left;
+            pair->second = top.second->left;
+            pair = (node_pair *)work_stack_push(pairs);
+            pair->first = top.first->right;
+            pair->second = top.second->right;
+        }
+    }
+    return same;
+}
+
+static void grow_hoisted(loop_analysis *a) {
+    a->hoistCapacity = a->hoistCapacity ? a->hoistCapacity * 2 : 64;
+    a->hashes = (unsigned *)realloc(a->hashes, a->hoistCapacity * sizeof(unsigned));
+    a->hoisted = (TreeNode **)realloc(a->hoisted, a->hoistCapacity * sizeof(TreeNode *));
+    a->temps = (const char **)realloc(a->temps, a->hoistCapacity * sizeof(const char *));
+    a->slotOf = (int *)realloc(a->slotOf, a->hoistCapacity * sizeof(int));
+
+    free(a->slots);  // rehash into a table twice as large as the expressions it may hold
+    a->slotCapacity = 2 * a->hoistCapacity;
+    a->slots = (int *)malloc(a->slotCapacity * sizeof(int));
+    for (int s = 0; s < a->slotCapacity; s++) a->slots[s] = -1;
+    for (int h = 0; h < a->hoistCount; h++) {
+        int slot = (int)(a->hashes[h] & (unsigned)(a->slotCapacity - 1));
+        while (a->slots[slot] >= 0) slot = (slot + 1) & (a->slotCapacity - 1);
+        a->slots[slot] = h;
+        a->slotOf[h] = slot;
+    }
+}
+
+// a variable read in place of an invariant expression: the first time the expression is seen in this loop, a new
+// temporary is assigned it at the end of the preheader; the same expression elsewhere in the loop shares it
+static TreeNode *hoist(loop_analysis *a, const natural_loop *loop, TreeNode *expression, unsigned hash) {
+    if (a->hoistCount == a->hoistCapacity) grow_hoisted(a);
+    int slot = (int)(hash & (unsigned)(a->slotCapacity - 1));
+    int found = -1;
+    for (;;) {
+        int h = a->slots[slot];
+        if (h < 0 || h >= a->hoistCount || a->slotOf[h] != slot) break;  // empty, or left over from an earlier loop
+        if (a->hashes[h] == hash && same_expression(a, a->hoisted[h], expression)) {
+            found = h;
+            break;
+        }
+        slot = (slot + 1) & (a->slotCapacity - 1);
+    }
+
+    if (found < 0) {
+        char name[16];
+        int length = snprintf(name, sizeof(name), "_l%d", a->tempCount++);  // no identifier starts with '_'
+        found = a->hoistCount++;
+        a->hashes[found] = hash;
+        a->hoisted[found] = expression;
+        a->temps[found] = intern_name(a->names, name, (size_t)length);
+        a->slots[slot] = found;
+        a->slotOf[found] = slot;
+
+        TreeNode *target = create_node(a->nodes, NODE_ID, NULL, NULL, a->temps[found]);
+        TreeNode *assignment = create_node(a->nodes, NODE_ASSIGNMENT, target, expression, NULL);
+        target->line = assignment->line = expression->line;  // profiled with the line it came from
+        add_block_statement(a->cfg, loop->preheader, assignment);
+        a->plan->hoisted++;
+    }
+
+    TreeNode *node = create_node(a->nodes, NODE_ID, NULL, NULL, a->temps[found]);
+    node->line = expression->line;
+    return node;
+}
+
+// copy of an expression whose largest invariant parts read temporaries computed before the loop; a division only
+// moves out of a block that runs in every iteration, so hoisting never divides where the loop would not have
+static TreeNode *hoist_expression(loop_analysis *a, const natural_loop *loop, TreeNode *root, int mayDivide) {
+    work_stack *stack = &a->stack;
+    ((hoist_frame *)work_stack_push(stack))->node = root;
+    TreeNode *result = NULL;
+    int invariant = 0;  // of the most recently finished node
+    unsigned hash = 0;
+
+    while (stack->count > 0) {
+        hoist_frame *frame = (hoist_frame *)work_stack_top(stack);
+        TreeNode *node = frame->node;
+        if (node->left == NULL || node->right == NULL) {
+            result = node;
+            invariant = node->type == NODE_NUMBER || (node->type == NODE_ID && !assigned_in_loop(a, node->value));
+            hash = leaf_hash(node);
+            work_stack_pop(stack);
+            continue;
+        }
+        if (frame->step == 1) {
+            frame->left = result;
+            frame->leftInvariant = invariant;
+            frame->leftHash = hash;
+        }
+        if (frame->step < 2) {
+            TreeNode *operand = frame->step++ == 0 ? node->left : node->right;
+            ((hoist_frame *)work_stack_push(stack))->node = operand;  // frame is stale from here on
+            continue;
+        }
+
+        TreeNode *left = frame->left;
+        TreeNode *right = result;
+        int rightInvariant = invariant;
+        unsigned rightHash = hash;
+        invariant = is_arithmetic(node->type) && frame->leftInvariant && rightInvariant &&
+                    (node->type != NODE_DIVIDE || mayDivide);
+        if (!invariant) {  // the invariant operands are as large as they get
+            if (frame->leftInvariant && !is_leaf(left)) left = hoist(a, loop, left, frame->leftHash);
+            if (rightInvariant && !is_leaf(right)) right = hoist(a, loop, right, rightHash);
+        }
+        hash = node_hash(node->type, frame->leftHash, rightHash);
+        if (left != node->left || right != node->right) {
+            result = create_node(a->nodes, node->type, left, right, NULL);
+            result->line = node->line;
+        } else {
+            result = node;
+        }
+        work_stack_pop(stack);
+    }
+    if (invariant && !is_leaf(result)) result = hoist(a, loop, result, hash);
+    return result;
+}
+
+static void hoist_invariants(loop_analysis *a, int index) {
+    control_flow_graph *cfg = a->cfg;
+    const natural_loop *loop = &a->plan->loops[index];
+    count_assignments(a, loop);
+    int every = mark_every_iteration(a, loop);
+    a->hoistCount = 0;
+
+    for (int i = 0; i < loop->blockCount; i++) {
+        int b = loop->blocks[i];
+        basic_block *block = &cfg->blocks[b];
+        int mayDivide = a->blockMark[b] == every;
+        if (block->count > a->statementCapacity) {
+            a->statementCapacity = block->count * 2;
+            a->statements = (TreeNode **)realloc(a->statements, a->statementCapacity * sizeof(TreeNode *));
+        }
+
+        int changed = 0;
+        for (int s = 0; s < block->count; s++) {
+            TreeNode *statement = block->statements[s].node;
+            if (statement->type == NODE_ASSIGNMENT) {
+                TreeNode *right = hoist_expression(a, loop, statement->right, mayDivide);
+                if (right != statement->right) {
+                    TreeNode *copy = create_node(a->nodes, NODE_ASSIGNMENT, statement->left, right, NULL);
+                    copy->line = statement->line;
+                    statement = copy;
+                    changed = 1;
+                }
+            }
+            a->statements[s] = statement;
+        }
+        TreeNode *condition = block->condition;
+        if (block->exit == EXIT_BRANCH) condition = hoist_expression(a, loop, condition, mayDivide);
+
+        if (changed) {
+            int count = block->count;
+            block->count = 0;  // rebuilt so the statements' uses name the temporaries
+            for (int s = 0; s < count; s++) add_block_statement(cfg, b, a->statements[s]);
+        }
+        if (condition != block->condition) set_block_condition(cfg, b, condition);
+    }
+}
+
+// value of a variable when control leaves block, known when a number was last assigned to it on every way there
+static int entry_value(const loop_analysis *a, int block, int variable, int *value) {
+    const control_flow_graph *cfg = a->cfg;
+    for (int hops = 0; hops < cfg->count; hops++) {
+        const basic_block *b = &cfg->blocks[block];
+        for (int s = b->count - 1; s >= 0; s--) {
+            if (b->statements[s].target != variable) continue;
+            const TreeNode *node = b->statements[s].node;
+            if (node->type != NODE_ASSIGNMENT || node->right->type != NODE_NUMBER) return 0;
+            *value = node->right->number;
+            return 1;
+        }
+        if (predecessor_count(a, block) != 1) return 0;  // values from several paths meet here
+        block = a->preds[a->predStart[block]];
+    }
+    return 0;
+}
+
+// a variable whose one assignment in the loop adds a constant to it, in a block every iteration runs once,
+// with a known value on entry
+static int stepped_variable(const loop_analysis *a, int index, int every, int variable, int *initial, int *step) {
+    if (variable < 0 || variable >= a->variableCapacity) return 0;
+    if (a->variableMark[variable] != a->variableStamp || a->assignments[variable] != 1) return 0;
+    int block = a->assignedBlock[variable];
+    if (a->innermost[block] != index || a->blockMark[block] != every) return 0;  // nested loops run it more often
+
+    const TreeNode *node = a->assignment[variable]->node;
+    if (node->type != NODE_ASSIGNMENT) return 0;
+    const TreeNode *right = node->right;
+    if (right->type != NODE_ADD && right->type != NODE_SUBTRACT) return 0;
+    const TreeNode *self = right->left;
+    const TreeNode *amount = right->right;
+    if (right->type == NODE_ADD && self->type == NODE_NUMBER) {  // 1 + i
+        self = right->right;
+        amount = right->left;
+    }
+    if (self->type != NODE_ID || self->value != node->left->value || amount->type != NODE_NUMBER) return 0;
+    *step = right->type == NODE_ADD ? amount->number : -amount->number;
+    if (*step == 0 || *step < -INDEX_LIMIT || *step > INDEX_LIMIT) return 0;  // INCi and DECi take it as an address
+    return entry_value(a, a->plan->loops[index].preheader, variable, initial);
+}
+
+// iterations before the until test holds, the tested variable having been stepped before each test;
+// 0 when it never holds and the variable would run away
+static long long count_iterations(const TreeNode *condition, int testedLeft, long long initial, long long step, long long bound) {
+    if (condition->type == NODE_EQ) {
+        long long distance = bound - initial;
+        if (distance % step != 0 || distance / step < 1) return 0;
+        return distance / step;
+    }
+    if (testedLeft) {  // until i < bound
+        if (initial + step < bound) return 1;
+        return step > 0 ? 0 : (initial - bound) / -step + 1;
+    }
+    if (initial + step > bound) return 1;  // until bound < i
+    return step < 0 ? 0 : (bound - initial) / step + 1;
+}
+
+static void add_induction(loop_analysis *a, natural_loop *loop, int variable, int initial, int step, long long iterations) {
+    long long last = initial + iterations * step;  // the values in between lie between the first and the last
+    if (initial < -INDEX_LIMIT || initial > INDEX_LIMIT || last < -INDEX_LIMIT || last > INDEX_LIMIT) return;
+    int reg = 1;
+    while (reg <= LOOP_REGISTERS && (loop->registers >> reg) & 1) reg++;  // enclosing loops keep theirs
+    if (reg > LOOP_REGISTERS) return;
+
+    loop_plan *plan = a->plan;
+    plan->inductions = (induction_variable *)realloc(plan->inductions, (plan->inductionCount + 1) * sizeof(induction_variable));
+    induction_variable *induction = &plan->inductions[plan->inductionCount++];
+    induction->name = a->cfg->variables.names[variable];
+    induction->variable = variable;
+    induction->reg = reg;
+    induction->initial = initial;
+    induction->step = step;
+    loop->registers |= 1 << reg;
+    loop->inductionCount++;
+}
+
+// the variable of the until test, when it is stepped toward a number so the loop runs a known number of times,
+// and every other variable stepped along with it, as long as all their values fit in an index register
+static void find_inductions(loop_analysis *a, int index) {
+    control_flow_graph *cfg = a->cfg;
+    loop_plan *plan = a->plan;
+    natural_loop *loop = &plan->loops[index];
+    loop->firstInduction = plan->inductionCount;
+    loop->registers = loop->parent >= 0 ? plan->loops[loop->parent].registers : 0;
+
+    const TreeNode *condition = cfg->blocks[loop->latch].condition;
+    if (condition->type != NODE_EQ && condition->type != NODE_LT) return;
+    const TreeNode *tested = condition->left;
+    const TreeNode *bound = condition->right;
+    int testedLeft = tested->type == NODE_ID;
+    if (!testedLeft) {
+        tested = condition->right;
+        bound = condition->left;
+    }
+    if (tested->type != NODE_ID || bound->type != NODE_NUMBER) return;
+
+    count_assignments(a, loop);
+    int every = mark_every_iteration(a, loop);
+    int variable = cfg_variable(cfg, tested->value);
+    int initial;
+    int step;
+    if (!stepped_variable(a, index, every, variable, &initial, &step)) return;
+    long long iterations = count_iterations(condition, testedLeft, initial, step, bound->number);
+    if (iterations <= 0) return;
+    add_induction(a, loop, variable, initial, step, iterations);
+
+    for (int i = 0; i < loop->blockCount; i++) {
+        const basic_block *block = &cfg->blocks[loop->blocks[i]];
+        for (int s = 0; s < block->count; s++) {
+            int other = block->statements[s].target;
+            if (other == variable || !stepped_variable(a, index, every, other, &initial, &step)) continue;
+            add_induction(a, loop, other, initial, step, iterations);
+        }
+    }
+}
+
+void optimize_loops(control_flow_graph *cfg, arena *nodes, name_pool *names, loop_plan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    if (cfg->count == 0) return;
+
+    loop_analysis a;
+    memset(&a, 0, sizeof(a));
+    a.cfg = cfg;
+    a.nodes = nodes;
+    a.names = names;
+    a.plan = plan;
+    a.blockMark = (int *)calloc(cfg->count, sizeof(int));
+    work_stack_init(&a.stack, sizeof(hoist_frame));
+    work_stack_init(&a.pairs, sizeof(node_pair));
+
+    find_predecessors(&a);
+    order_blocks(&a);
+    find_dominators(&a);
+    find_loops(&a);
+    for (int l = 0; l < plan->count; l++) hoist_invariants(&a, l);  // outer loops first, so an expression moves out as far as it can
+    for (int l = 0; l < plan->count; l++) find_inductions(&a, l);
+
+    free(a.predStart);
+    free(a.preds);
+    free(a.order);
+    free(a.rank);
+    free(a.idom);
+    free(a.enter);
+    free(a.leave);
+    free(a.innermost);
+    free(a.blockMark);
+    free(a.variableMark);
+    free(a.assignments);
+    free(a.assignment);
+    free(a.assignedBlock);
+    free(a.hashes);
+    free(a.hoisted);
+    free(a.temps);
+    free(a.slotOf);
+    free(a.slots);
+    work_stack_free(&a.stack);
+    work_stack_free(&a.pairs);
+    free(a.statements);
+}
+
+void print_loop_stats(FILE *logFile, const loop_plan *plan) {
+    fprintf(logFile, "Loops: %d found, %d invariant expressions computed before them, %d variables kept in index registers\n",
+            plan->count, plan->hoisted, plan->inductionCount);
+}
+
+void free_loop_plan(loop_plan *plan) {
+    for (int l = 0; l < plan->count; l++) free(plan->loops[l].blocks);
+    free(plan->loops);
+    free(plan->inductions);
+    memset(plan, 0, sizeof(*plan));
+}
@@ -0,0 +1,50 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "cfg.h"
+#include "../arena/arena.h"
+#include "../symbol_table/symbol_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOP_REGISTERS 4  // index registers rI1-rI4 hold loop variables; rI5 and rI6 belong to the I/O code
+
+typedef struct {
+    int head;            // first block of the body, where the back edge returns
+    int latch;           // block ending in the until test, the only one leaving the loop
+    int preheader;       // the one block outside the loop that jumps to head
+    int exit;            // block after the loop, entered from latch alone
+    int parent;          // innermost loop around this one, -1 for none
+    int *blocks;         // every block of the loop, those of nested loops included
+    int blockCount;
+    int firstInduction;  // plan->inductions[firstInduction..firstInduction + inductionCount) live in its registers
+    int inductionCount;
+    int registers;       // bit r set when rIr holds a variable of this loop or of one around it
+} natural_loop;
+
+typedef struct {
+    const char *name;    // interned variable name
+    int variable;        // its bit in the liveness sets
+    int reg;             // index register, 1 to LOOP_REGISTERS
+    int initial;         // value when the loop is entered
+    int step;            // added by its one assignment in the loop, once per iteration
+} induction_variable;
+
+typedef struct {
+    natural_loop *loops;  // outer loops before the loops they contain
+    int count;
+    induction_variable *inductions;
+    int inductionCount;
+    int hoisted;          // loop-invariant expressions computed once before their loop
+} loop_plan;
+
+// find the natural loops of the graph; compute the expressions no iteration changes into temporaries at the end of
+// each loop's preheader, and pick the variables stepped by a constant once per iteration whose values provably fit in
+// an index register, so the code generator keeps them there; new nodes come from nodes and the temporaries' names from names
+void optimize_loops(control_flow_graph *cfg, arena *nodes, name_pool *names, loop_plan *plan);
+void print_loop_stats(FILE *logFile, const loop_plan *plan);  // summary for the log file
+void free_loop_plan(loop_plan *plan);
+
+#endif
@@ -0,0 +1,250 @@
+#include "partial_eval.h"
+#include "../syntax_tree/syntax_tree.h"
+
+#define MIX_WORD_LIMIT 1073741823LL  // largest magnitude a MIX word can hold (five 6-bit bytes)
+
+typedef struct {
+    const TreeNode *node;
+    int step;        // operands evaluated so far
+    long long left;  // value of the left operand
+} eval_frame;
+
+typedef enum {
+    EVAL_DONE,
+    EVAL_OVERFLOW,  // MIX would overflow or divide by zero on the way
+    EVAL_UNKNOWN    // needs a value read from input
+} eval_result;
+
+typedef struct {
+    TreeNode *read;    // a read kept as it is, or NULL for a write
+    const char *name;  // variable the source program writes
+    int value;
+    int line;          // source line of the write
+} prologue_step;
+
+static eval_result evaluate(const control_flow_graph *cfg, const int *values, const char *known, work_stack *stack, const TreeNode *node, long long *result) {
+    int base = stack->count;
+    ((eval_frame *)work_stack_push(stack))->node = node;
+    long long last = 0;  // value of the most recently finished operand
+
+    while (stack->count > base) {
+        eval_frame *frame = (eval_frame *)work_stack_top(stack);
+        node = frame->node;
+        if (node->type == NODE_ID && !known[cfg_variable(cfg, node->value)]) {
+            stack->count = base;
+            return EVAL_UNKNOWN;
+        }
+        if (node->type == NODE_NUMBER || node->type == NODE_ID) {
+            last = node->type == NODE_NUMBER ? node->number : values[cfg_variable(cfg, node->value)];
+            work_stack_pop(stack);
+            continue;
+        }
+        if (frame->step == 0) {
+            frame->step = 1;
+            ((eval_frame *)work_stack_push(stack))->node = node->left;  // frame is stale from here on
+            continue;
+        }
+        if (frame->step == 1) {
+            frame->left = last;
+            frame->step = 2;
+            ((eval_frame *)work_stack_push(stack))->node = node->right;
+            continue;
+        }
+
+        long long a = frame->left;
+        long long b = last;
+        switch (node->type) {
+            case NODE_ADD: last = a + b; break;
+            case NODE_SUBTRACT: last = a - b; break;
+            case NODE_MULTIPLY: last = a * b; break;
+            case NODE_DIVIDE:
+                if (b == 0) {
+                    stack->count = base;
+                    return EVAL_OVERFLOW;
+                }
+                last = a / b;  // truncates toward zero like MIX DIV
+                break;
+            case NODE_LT: last = a < b; break;
+            case NODE_EQ: last = a == b; break;
+            default: last = 0; break;
+        }
+        if (last > MIX_WORD_LIMIT || last < -MIX_WORD_LIMIT) {  // rA would overflow, leave it to run time
+            stack->count = base;
+            return EVAL_OVERFLOW;
+        }
+        work_stack_pop(stack);
+    }
+    *result = last;
+    return EVAL_DONE;
+}
+
+static const char *stop_reason(eval_result result) {
+    return result == EVAL_UNKNOWN ? "a value read from input" : "an overflow";
+}
+
+static TreeNode *number_node(arena *nodes, int value) {
+    TreeNode *node = create_node(nodes, NODE_NUMBER, NULL, NULL, NULL);
+    node->number = value;
+    return node;
+}
+
+void partial_evaluate(control_flow_graph *cfg, arena *nodes, long long budget, peval_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->resumeBlock = -1;
+    if (cfg->count == 0) return;
+
+    int count = cfg->variables.count;
+    int *values = (int *)calloc(count + 1, sizeof(int));  // MIX memory starts out zero
+    char *known = (char *)malloc(count + 1);
+    memset(known, 1, count + 1);
+    char *readInto = (char *)calloc(count + 1, 1);  // per variable: a read in the prologue stored it
+    prologue_step *steps = NULL;
+    int stepCount = 0;
+    int stepCapacity = 0;
+    int evaluated = 0;  // assignments, writes and conditions done at compile time; reads and jumps gain nothing
+    work_stack stack;
+    work_stack_init(&stack, sizeof(eval_frame));
+
+    // run until the program ends or something stops it; block and index are then the next thing to run
+    int block = 0;
+    int index = 0;
+    while (stats->stoppedBy == NULL) {
+        const basic_block *current = &cfg->blocks[block];
+        if (stats->steps == budget) {
+            stats->stoppedBy = "the step budget";
+            break;
+        }
+
+        if (index < current->count) {
+            const cfg_statement *statement = &current->statements[index];
+            prologue_step step = { NULL, NULL, 0, 0 };
+            if (statement->type == NODE_READ) {
+                step.read = statement->node;  // the input itself stays, what only depends on other values goes on
+                known[statement->target] = 0;
+                readInto[statement->target] = 1;
+            } else if (statement->type == NODE_WRITE) {
+                int variable = cfg_variable(cfg, statement->node->value);
+                if (!known[variable]) {
+                    stats->stoppedBy = stop_reason(EVAL_UNKNOWN);
+                } else if (stats->writes == PEVAL_MAX_WRITES) {
+                    stats->stoppedBy = "the write limit";
+                } else {
+                    step.name = statement->node->value;
+                    step.value = values[variable];
+                    step.line = statement->node->line;
+                    stats->writes++;
+                }
+            } else {
+                long long value;
+                eval_result result = evaluate(cfg, values, known, &stack, statement->node->right, &value);
+                if (result == EVAL_DONE) {
+                    values[statement->target] = (int)value;
+                    known[statement->target] = 1;
+                } else {
+                    stats->stoppedBy = stop_reason(result);
+                }
+            }
+            if (stats->stoppedBy != NULL) break;
+            evaluated += step.read == NULL;
+            if (step.read != NULL || step.name != NULL) {
+                if (stepCount == stepCapacity) {
+                    stepCapacity = stepCapacity ? stepCapacity * 2 : 64;
+                    steps = (prologue_step *)realloc(steps, stepCapacity * sizeof(prologue_step));
+                }
+                steps[stepCount++] = step;
+            }
+            index++;
+            stats->steps++;
+            continue;
+        }
+
+        long long holds = 1;
+        if (current->exit == EXIT_HALT) {
+            stats->finished = 1;
+            break;
+        }
+        if (current->exit == EXIT_BRANCH) {
+            eval_result result = evaluate(cfg, values, known, &stack, current->condition, &holds);
+            if (result != EVAL_DONE) {
+                stats->stoppedBy = stop_reason(result);
+                break;
+            }
+            evaluated++;
+        }
+        block = holds ? current->target : current->otherwise;
+        index = 0;
+        stats->steps++;
+    }
+    work_stack_free(&stack);
+
+    if (evaluated == 0 && !stats->finished) {  // nothing to replace
+        free(values);
+        free(known);
+        free(readInto);
+        free(steps);
+        return;
+    }
+
+    // the rest of a block cut in the middle goes into a block of its own, since the front of it may run again later
+    int resume = block;
+    if (!stats->finished && (index > 0 || block == 0)) {
+        resume = add_block(cfg, "RESUME", 0);
+        basic_block *from = &cfg->blocks[block];
+        basic_block *to = &cfg->blocks[resume];
+        to->capacity = from->count - index + 1;
+        to->statements = (cfg_statement *)malloc(to->capacity * sizeof(cfg_statement));
+        to->count = from->count - index;
+        memcpy(to->statements, from->statements + index, to->count * sizeof(cfg_statement));  // their uses stay valid
+        to->exit = from->exit;
+        to->condition = from->condition;
+        to->conditionFirstUse = from->conditionFirstUse;
+        to->conditionUseCount = from->conditionUseCount;
+        to->target = from->target;
+        to->otherwise = from->otherwise;
+    }
+
+    // the entry becomes the reads and the output so far, then the values the rest of the program may use
+    basic_block *entry = &cfg->blocks[0];
+    entry->count = 0;
+    entry->condition = NULL;
+    entry->conditionUseCount = 0;
+    entry->otherwise = -1;
+    for (int i = 0; i < stepCount; i++) {
+        TreeNode *statement = steps[i].read;
+        if (statement == NULL) {
+            statement = create_node(nodes, NODE_WRITE, number_node(nodes, steps[i].value), NULL, steps[i].name);
+            statement->line = steps[i].line;  // the profile charges the precomputed write to its source line
+        }
+        add_block_statement(cfg, 0, statement);
+    }
+    if (!stats->finished) {
+        for (int v = 0; v < count; v++) {
+            // a variable read before any store keeps a word that is still zero, unless a read above filled it
+            if (!known[v] || (values[v] == 0 && !readInto[v])) continue;
+            TreeNode *target = create_node(nodes, NODE_ID, NULL, NULL, cfg->variables.names[v]);
+            add_block_statement(cfg, 0, create_node(nodes, NODE_ASSIGNMENT, target, number_node(nodes, values[v]), NULL));
+            stats->stores++;  // dead code elimination drops the ones nobody reads
+        }
+        stats->resumeBlock = resume;
+    }
+    entry = &cfg->blocks[0];
+    entry->exit = stats->finished ? EXIT_HALT : EXIT_JUMP;
+    entry->target = stats->finished ? -1 : resume;
+
+    free(values);
+    free(known);
+    free(readInto);
+    free(steps);
+}
+
+void print_peval_stats(FILE *logFile, const control_flow_graph *cfg, const peval_stats *stats) {
+    fprintf(logFile, "Partial evaluation: %lld steps run at compile time, %d writes precomputed", stats->steps, stats->writes);
+    if (stats->finished) {
+        fprintf(logFile, ", the whole program\n");
+    } else if (stats->resumeBlock >= 0) {
+        const basic_block *resume = &cfg->blocks[stats->resumeBlock];
+        fprintf(logFile, ", %d values set, stopped by %s at %s%d\n", stats->stores, stats->stoppedBy, resume->labelPrefix, resume->labelNumber);
+    } else {
+        fprintf(logFile, ", stopped by %s before anything could be precomputed\n", stats->stoppedBy);
+    }
+}
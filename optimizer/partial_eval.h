@@ -0,0 +1,28 @@
+#ifndef PARTIAL_EVAL_H
+#define PARTIAL_EVAL_H
+
+#include "cfg.h"
+#include "../arena/arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PEVAL_DEFAULT_STEPS 1000000  // statements and branches run at compile time by a bare --peval
+#define PEVAL_MAX_WRITES 100         // precomputed writes kept; each takes seven instructions and two literals of MIX memory
+
+typedef struct {
+    long long steps;       // statements and branches run at compile time
+    int writes;            // writes replaced by their printed value
+    int stores;            // variables set to their known value before the rest of the program runs
+    int finished;          // the program ran to its end, only its output is left
+    const char *stoppedBy; // why evaluation stopped short: a value read from input, the step budget, the write limit or an overflow
+    int resumeBlock;       // where the generated program carries on, -1 when finished
+} peval_stats;
+
+// run the program from its entry until something needs a value read from input, and replace that part by its reads,
+// its output and the final variable values; new nodes come from nodes, and eliminate_dead_code removes the blocks left behind
+void partial_evaluate(control_flow_graph *cfg, arena *nodes, long long budget, peval_stats *stats);
+void print_peval_stats(FILE *logFile, const control_flow_graph *cfg, const peval_stats *stats);  // summary for the log file
+
+#endif
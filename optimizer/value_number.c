@@ -0,0 +1,395 @@
+#include "value_number.h"
+
+#define VALUE_VARIABLE -1  // key type of a variable between two of its stores
+#define VALUE_CONSTANT -2  // key type of a number
+#define MARK_DEFINE 1      // first occurrence of a reused value, computed into its temporary
+#define MARK_REUSE 2       // later occurrence, read from the temporary instead
+#define SELECT_ROUNDS 8    // passes dropping values that turn out to be used too rarely
+
+typedef struct {
+    int type;   // operator, VALUE_VARIABLE or VALUE_CONSTANT
+    int left;   // operand values, the variable and its version, or the number
+    int right;
+} value_key;
+
+typedef struct {
+    TreeNode *node;
+    int index;      // pre-order position of the node among the block's occurrences
+    int step;       // operands visited so far
+    TreeNode *left; // rewritten left operand
+} rewrite_frame;
+
+typedef struct {
+    control_flow_graph *cfg;
+    arena *nodes;
+    name_pool *names;
+
+    int *values;      // per occurrence in pre-order: its value number
+    int *sizes;       // nodes in its subtree, itself included
+    char *marks;      // MARK_DEFINE, MARK_REUSE or 0
+    int count;
+    int capacity;
+
+    value_key *keys;  // per value number
+    int *costs;       // time units to compute it into rA, operands included
+    int *uses;        // occurrences not inside a reused value
+    int *slotOf;      // hash slot holding it
+    char *chosen;     // kept in a temporary
+    char *defined;    // its temporary is set before the statement being scanned
+    const char **temps;
+    int valueCount;
+    int valueCapacity;
+    int *slots;       // open-addressing index of the keys; a slot counts only if slotOf points back at it
+    int slotCapacity;
+
+    int *versions;     // per variable: stores to it so far in the current block
+    int *versionBlock; // block versions[v] belongs to, so nothing is cleared between blocks
+    int tempCount;
+    work_stack stack;
+    TreeNode **statements; // the rewritten block
+    int statementCount;
+    int statementCapacity;
+} numbering;
+
+static int operator_cost(NodeType type) {
+    switch (type) {
+        case NODE_ADD:
+        case NODE_SUBTRACT: return 2;        // ADD or SUB
+        case NODE_MULTIPLY: return 10 + 2;   // MUL and SLAX
+        case NODE_DIVIDE: return 2 + 12;     // SRAX and DIV
+        default: return 0;
+    }
+}
+
+static int is_arithmetic(int type) {
+    return type == NODE_ADD || type == NODE_SUBTRACT || type == NODE_MULTIPLY || type == NODE_DIVIDE;
+}
+
+// worth a temporary: the computations saved pay for storing it once and loading it at every use
+static int worth_reusing(int cost, int uses) {
+    return uses >= 2 && cost * (uses - 1) > 2 * (uses + 1);
+}
+
+static unsigned hash_key(value_key key) {
+    unsigned hash = (unsigned)key.type * 2654435761u;
+    hash = (hash ^ (unsigned)key.left) * 2246822519u;
+    hash = (hash ^ (unsigned)key.right) * 3266489917u;
+    return hash ^ (hash >> 15);
+}
+
+static void grow_values(numbering *n) {
+    n->valueCapacity = n->valueCapacity ? n->valueCapacity * 2 : 256;
+    n->keys = (value_key *)realloc(n->keys, n->valueCapacity * sizeof(value_key));
+    n->costs = (int *)realloc(n->costs, n->valueCapacity * sizeof(int));
+    n->uses = (int *)realloc(n->uses, n->valueCapacity * sizeof(int));
+    n->slotOf = (int *)realloc(n->slotOf, n->valueCapacity * sizeof(int));
+    n->chosen = (char *)realloc(n->chosen, n->valueCapacity);
+    n->defined = (char *)realloc(n->defined, n->valueCapacity);
+    n->temps = (const char **)realloc(n->temps, n->valueCapacity * sizeof(const char *));
+
+    free(n->slots);  // rehash into a table twice as large as the values it may hold
+    n->slotCapacity = 2 * n->valueCapacity;
+    n->slots = (int *)malloc(n->slotCapacity * sizeof(int));
+    for (int s = 0; s < n->slotCapacity; s++) n->slots[s] = -1;
+    for (int v = 0; v < n->valueCount; v++) {
+        int slot = (int)(hash_key(n->keys[v]) & (unsigned)(n->slotCapacity - 1));
+        while (n->slots[slot] >= 0) slot = (slot + 1) & (n->slotCapacity - 1);
+        n->slots[slot] = v;
+        n->slotOf[v] = slot;
+    }
+}
+
+// value number of a key, a new one the first time it is seen in the block
+static int lookup_value(numbering *n, value_key key, int cost) {
+    if (n->valueCount == n->valueCapacity) grow_values(n);
+    int slot = (int)(hash_key(key) & (unsigned)(n->slotCapacity - 1));
+    for (;;) {
+        int v = n->slots[slot];
+        if (v < 0 || v >= n->valueCount || n->slotOf[v] != slot) break;  // empty, or left over from an earlier block
+        if (n->keys[v].type == key.type && n->keys[v].left == key.left && n->keys[v].right == key.right) return v;
+        slot = (slot + 1) & (n->slotCapacity - 1);
+    }
+    int v = n->valueCount++;
+    n->keys[v] = key;
+    n->costs[v] = cost;
+    n->uses[v] = 0;
+    n->chosen[v] = 0;
+    n->temps[v] = NULL;
+    n->slots[slot] = v;
+    n->slotOf[v] = slot;
+    return v;
+}
+
+static int add_occurrence(numbering *n) {
+    if (n->count == n->capacity) {
+        n->capacity = n->capacity ? n->capacity * 2 : 256;
+        n->values = (int *)realloc(n->values, n->capacity * sizeof(int));
+        n->sizes = (int *)realloc(n->sizes, n->capacity * sizeof(int));
+        n->marks = (char *)realloc(n->marks, n->capacity);
+    }
+    n->marks[n->count] = 0;
+    return n->count++;
+}
+
+static int variable_version(numbering *n, int block, int variable) {
+    if (n->versionBlock[variable] != block) {
+        n->versionBlock[variable] = block;
+        n->versions[variable] = 0;
+    }
+    return n->versions[variable];
+}
+
+// append the occurrences of an expression in pre-order, numbering each once its operands are numbered
+static void number_expression(numbering *n, int block, TreeNode *root) {
+    work_stack *stack = &n->stack;
+    rewrite_frame *frame = (rewrite_frame *)work_stack_push(stack);
+    frame->node = root;
+
+    while (stack->count > 0) {
+        frame = (rewrite_frame *)work_stack_top(stack);
+        TreeNode *node = frame->node;
+        if (frame->step == 0) frame->index = add_occurrence(n);
+        int index = frame->index;
+
+        if (node->left == NULL || node->right == NULL) {
+            value_key key = {VALUE_CONSTANT, node->number, 0};
+            if (node->type == NODE_ID) {
+                int variable = cfg_variable(n->cfg, node->value);
+                key.type = VALUE_VARIABLE;
+                key.left = variable;
+                key.right = variable_version(n, block, variable);
+            }
+            n->values[index] = lookup_value(n, key, 0);
+            n->sizes[index] = 1;
+            n->uses[n->values[index]]++;
+            work_stack_pop(stack);
+            continue;
+        }
+
+        if (frame->step < 2) {
+            TreeNode *operand = frame->step++ == 0 ? node->left : node->right;
+            rewrite_frame *child = (rewrite_frame *)work_stack_push(stack);  // frame is stale from here on
+            child->node = operand;
+            continue;
+        }
+
+        int left = n->values[index + 1];
+        int right = n->values[index + 1 + n->sizes[index + 1]];
+        if ((node->type == NODE_ADD || node->type == NODE_MULTIPLY) && left > right) {  // a + b and b + a are one value
+            int swap = left;
+            left = right;
+            right = swap;
+        }
+        value_key key = {node->type, left, right};
+        n->values[index] = lookup_value(n, key, operator_cost(node->type) + n->costs[left] + n->costs[right]);
+        n->sizes[index] = n->count - index;
+        n->uses[n->values[index]]++;
+        work_stack_pop(stack);
+    }
+}
+
+// count the uses of the chosen values as the rewrite would make them: the first occurrence is computed with its
+// operands, every later one is a load that hides its operands; with mark set, record that decision per occurrence
+static void scan_uses_of_chosen(numbering *n, int mark) {
+    for (int v = 0; v < n->valueCount; v++) {
+        if (n->chosen[v]) n->uses[v] = 0;
+        n->defined[v] = 0;
+    }
+    for (int k = 0; k < n->count;) {
+        int v = n->values[k];
+        if (!n->chosen[v]) {
+            k++;
+            continue;
+        }
+        n->uses[v]++;
+        if (mark) n->marks[k] = n->defined[v] ? MARK_REUSE : MARK_DEFINE;
+        if (n->defined[v]) {
+            k += n->sizes[k];
+        } else {
+            n->defined[v] = 1;
+            k++;
+        }
+    }
+}
+
+static TreeNode *temporary(numbering *n, int value, int line) {
+    if (n->temps[value] == NULL) {
+        char name[16];
+        int length = snprintf(name, sizeof(name), "_t%d", n->tempCount++);  // no identifier starts with '_'
+        n->temps[value] = intern_name(n->names, name, (size_t)length);
+    }
+    TreeNode *node = create_node(n->nodes, NODE_ID, NULL, NULL, n->temps[value]);
+    node->line = line;
+    return node;
+}
+
+static void add_rewritten(numbering *n, TreeNode *statement) {
+    if (n->statementCount == n->statementCapacity) {
+        n->statementCapacity = n->statementCapacity ? n->statementCapacity * 2 : 16;
+        n->statements = (TreeNode **)realloc(n->statements, n->statementCapacity * sizeof(TreeNode *));
+    }
+    n->statements[n->statementCount++] = statement;
+}
+
+// copy of an expression whose marked occurrences read their temporary; the assignments of temporaries first computed
+// here go to the rewritten block, each after those of its operands; nodes nothing changed under are shared
+static TreeNode *rewrite_expression(numbering *n, TreeNode *root, int *next, int line) {
+    work_stack *stack = &n->stack;
+    rewrite_frame *frame = (rewrite_frame *)work_stack_push(stack);
+    frame->node = root;
+    TreeNode *result = NULL;
+
+    while (stack->count > 0) {
+        frame = (rewrite_frame *)work_stack_top(stack);
+        TreeNode *node = frame->node;
+        if (frame->step == 0) {
+            frame->index = (*next)++;
+            if (n->marks[frame->index] == MARK_REUSE) {
+                result = temporary(n, n->values[frame->index], line);
+                *next = frame->index + n->sizes[frame->index];  // its operands are not evaluated here
+                work_stack_pop(stack);
+                continue;
+            }
+            if (node->left == NULL || node->right == NULL) {
+                result = node;
+                work_stack_pop(stack);
+                continue;
+            }
+        } else if (frame->step == 1) {
+            frame->left = result;
+        }
+
+        if (frame->step < 2) {
+            TreeNode *operand = frame->step++ == 0 ? node->left : node->right;
+            rewrite_frame *child = (rewrite_frame *)work_stack_push(stack);  // frame is stale from here on
+            child->node = operand;
+            continue;
+        }
+
+        if (frame->left != node->left || result != node->right) {
+            TreeNode *copy = create_node(n->nodes, node->type, frame->left, result, NULL);
+            copy->line = node->line;
+            result = copy;
+        } else {
+            result = node;
+        }
+        if (n->marks[frame->index] == MARK_DEFINE) {
+            int value = n->values[frame->index];
+            TreeNode *assignment = create_node(n->nodes, NODE_ASSIGNMENT, temporary(n, value, line), result, NULL);
+            assignment->line = line;
+            add_rewritten(n, assignment);
+            result = temporary(n, value, line);
+        }
+        work_stack_pop(stack);
+    }
+    return result;
+}
+
+static void number_block(numbering *n, int b, value_number_stats *stats) {
+    basic_block *block = &n->cfg->blocks[b];
+    n->count = 0;
+    n->valueCount = 0;  // value numbers are local to the block
+    for (int i = 0; i <= block->count; i++) {  // statements in order, then the condition
+        TreeNode *expression = NULL;
+        if (i < block->count && block->statements[i].type == NODE_ASSIGNMENT) expression = block->statements[i].node->right;
+        if (i == block->count && block->exit == EXIT_BRANCH) expression = block->condition;
+        if (expression != NULL) number_expression(n, b, expression);
+
+        int target = i < block->count ? block->statements[i].target : -1;
+        if (target >= 0) {  // later reads of the target see a new value
+            variable_version(n, b, target);
+            n->versions[target]++;
+        }
+    }
+
+    int anyChosen = 0;
+    for (int v = 0; v < n->valueCount; v++) {
+        n->chosen[v] = is_arithmetic(n->keys[v].type) && worth_reusing(n->costs[v], n->uses[v]);
+        anyChosen |= n->chosen[v];
+    }
+    if (!anyChosen) return;
+
+    // a value inside a reused value is used less than its occurrences say; drop what no longer pays until nothing changes
+    for (int round = 0, changed = 1; changed && round < SELECT_ROUNDS; round++) {
+        changed = 0;
+        scan_uses_of_chosen(n, 0);
+        for (int v = 0; v < n->valueCount; v++) {
+            if (n->chosen[v] && !worth_reusing(n->costs[v], n->uses[v])) {
+                n->chosen[v] = 0;
+                changed = 1;
+            }
+        }
+    }
+    scan_uses_of_chosen(n, 1);
+    anyChosen = 0;
+    for (int v = 0; v < n->valueCount; v++) {
+        if (!n->chosen[v]) continue;
+        anyChosen = 1;
+        stats->temporaries++;
+        stats->reuses += n->uses[v] - 1;
+    }
+    if (!anyChosen) return;
+
+    n->statementCount = 0;
+    int next = 0;
+    for (int i = 0; i < block->count; i++) {
+        TreeNode *statement = block->statements[i].node;
+        if (statement->type == NODE_ASSIGNMENT) {
+            TreeNode *right = rewrite_expression(n, statement->right, &next, statement->line);
+            if (right != statement->right) {
+                TreeNode *copy = create_node(n->nodes, NODE_ASSIGNMENT, statement->left, right, NULL);
+                copy->line = statement->line;
+                statement = copy;
+            }
+        }
+        add_rewritten(n, statement);
+    }
+    TreeNode *condition = block->condition;
+    if (block->exit == EXIT_BRANCH) condition = rewrite_expression(n, condition, &next, condition->line);
+
+    block->count = 0;  // rebuilt with the temporaries' assignments in place
+    for (int i = 0; i < n->statementCount; i++) add_block_statement(n->cfg, b, n->statements[i]);
+    if (condition != block->condition) set_block_condition(n->cfg, b, condition);
+}
+
+void number_values(control_flow_graph *cfg, arena *nodes, name_pool *names, value_number_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (cfg->count == 0) return;
+
+    numbering n;
+    memset(&n, 0, sizeof(n));
+    n.cfg = cfg;
+    n.nodes = nodes;
+    n.names = names;
+    work_stack_init(&n.stack, sizeof(rewrite_frame));
+    int variables = cfg->variables.count;  // temporaries added on the way are never numbered
+    n.versions = (int *)calloc(variables + 1, sizeof(int));
+    n.versionBlock = (int *)malloc((variables + 1) * sizeof(int));
+    for (int v = 0; v < variables; v++) n.versionBlock[v] = -1;
+    grow_values(&n);
+
+    for (int b = 0; b < cfg->count; b++) {
+        if (!cfg->blocks[b].removed) number_block(&n, b, stats);
+    }
+
+    work_stack_free(&n.stack);
+    free(n.values);
+    free(n.sizes);
+    free(n.marks);
+    free(n.keys);
+    free(n.costs);
+    free(n.uses);
+    free(n.slotOf);
+    free(n.chosen);
+    free(n.defined);
+    free(n.temps);
+    free(n.slots);
+    free(n.versions);
+    free(n.versionBlock);
+    free(n.statements);
+}
+
+void print_value_number_stats(FILE *logFile, const value_number_stats *stats) {
+    fprintf(logFile, "Value numbering: %d expressions kept in temporaries, %d recomputations removed\n",
+            stats->temporaries, stats->reuses);
+}
@@ -0,0 +1,23 @@
+#ifndef VALUE_NUMBER_H
+#define VALUE_NUMBER_H
+
+#include "cfg.h"
+#include "../arena/arena.h"
+#include "../symbol_table/symbol_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int temporaries;     // expressions computed once into a compiler temporary
+    int reuses;          // later computations of them replaced by the temporary
+} value_number_stats;
+
+// within each block, give every expression a value number from its operator and the values of its operands, a variable
+// taking a new value at each store; a costly value computed more than once is stored in a temporary before its first
+// use and read back from there; new nodes come from nodes and the temporaries' names from names
+void number_values(control_flow_graph *cfg, arena *nodes, name_pool *names, value_number_stats *stats);
+void print_value_number_stats(FILE *logFile, const value_number_stats *stats);  // summary for the log file
+
+#endif
@@ -0,0 +1,91 @@
+#include "line_profile.h"
+
+static void add_entry(line_map *map, int address, int line, int block) {
+    if (map->count == map->capacity) {
+        map->capacity = map->capacity ? map->capacity * 2 : 256;
+        map->entries = (line_map_entry *)realloc(map->entries, map->capacity * sizeof(line_map_entry));
+    }
+    line_map_entry *entry = &map->entries[map->count++];
+    entry->address = address;
+    entry->line = line;
+    entry->block = block;
+    if (line > map->lineCount) map->lineCount = line;
+}
+
+static void set_counter(line_map *map, int block, int address) {
+    if (block < 0) return;
+    if (block >= map->blockCount) {
+        map->counters = (int *)realloc(map->counters, (block + 1) * sizeof(int));
+        for (int b = map->blockCount; b <= block; b++) map->counters[b] = -1;
+        map->blockCount = block + 1;
+    }
+    map->counters[block] = address;
+}
+
+int read_line_map(const char *path, line_map *map) {
+    memset(map, 0, sizeof(*map));
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    char text[128];
+    while (fgets(text, sizeof(text), file) != NULL) {
+        int first, second, third;
+        if (text[0] == '#') continue;  // the column header
+        if (sscanf(text, "counter %d %d", &first, &second) == 2) {
+            set_counter(map, first, second);
+        } else if (sscanf(text, "%d %d %d", &first, &second, &third) == 3) {
+            add_entry(map, first, second, third);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+void print_line_profile(FILE *logFile, const line_map *map, const mix_machine *machine) {
+    fprintf(logFile, "\nPROFILE\n-------\n");
+    if (map->blockCount == 0) {
+        fprintf(logFile, "No block counters, the program was compiled without --profile\n");
+        return;
+    }
+
+    long long *runs = (long long *)calloc(map->lineCount + 1, sizeof(long long));
+    long long *units = (long long *)calloc(map->lineCount + 1, sizeof(long long));
+    char *hasCode = (char *)calloc(map->lineCount + 1, 1);
+    long long total = 0;
+    for (int i = 0; i < map->count; i++) {
+        const line_map_entry *entry = &map->entries[i];
+        // the I/O routines run once per read or write rather than once per block, so no counter covers them
+        if (entry->block < 0 || entry->block >= map->blockCount || map->counters[entry->block] < 0) continue;
+        if (entry->address < 0 || entry->address >= MIX_MEMORY_SIZE) continue;
+
+        long long count = machine->memory[map->counters[entry->block]] & MIX_MAGNITUDE_MASK;
+        long long time = count * mix_instruction_time(machine->memory[entry->address]);
+        if (count > runs[entry->line]) runs[entry->line] = count;  // a line split over blocks counts its busiest part
+        units[entry->line] += time;
+        hasCode[entry->line] = 1;
+        total += time;
+    }
+
+    fprintf(logFile, "Line       Runs    Time (u)\n");
+    for (int line = 1; line <= map->lineCount; line++) {
+        if (hasCode[line]) fprintf(logFile, "%4d %10lld %11lld\n", line, runs[line], units[line]);
+    }
+    if (hasCode[0]) fprintf(logFile, "added %9s %11lld\n", "", units[0]);  // counters, jumps between blocks, stores from --peval
+    fprintf(logFile, "Estimated: %lld u in the blocks; the I/O routines and device waits are not included\n", total);
+
+    fprintf(logFile, "Block runs:");  // the raw counters, by block number
+    for (int b = 0; b < map->blockCount; b++) {
+        if (map->counters[b] >= 0) fprintf(logFile, " %d:%u", b, machine->memory[map->counters[b]] & MIX_MAGNITUDE_MASK);
+    }
+    fprintf(logFile, "\n");
+
+    free(runs);
+    free(units);
+    free(hasCode);
+}
+
+void free_line_map(line_map *map) {
+    free(map->entries);
+    free(map->counters);
+    memset(map, 0, sizeof(*map));
+}
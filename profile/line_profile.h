@@ -0,0 +1,29 @@
+#ifndef LINE_PROFILE_H
+#define LINE_PROFILE_H
+
+#include "../simulator/mix_simulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int address;  // MIX address of an instruction word
+    int line;     // source line it was generated for, 0 for code the compiler adds
+    int block;    // basic block it runs in, -1 for the I/O routines
+} line_map_entry;
+
+typedef struct {
+    line_map_entry *entries;  // in address order
+    int count;
+    int capacity;
+    int *counters;            // address of the word counting the runs of each block, -1 for none
+    int blockCount;
+    int lineCount;            // highest source line in the map
+} line_map;
+
+int read_line_map(const char *path, line_map *map);  // load a map written by generate_mix_code, 0 on success
+void print_line_profile(FILE *logFile, const line_map *map, const mix_machine *machine);  // runs and time units per source line from the counters left in memory
+void free_line_map(line_map *map);
+
+#endif
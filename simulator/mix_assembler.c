@@ -0,0 +1,494 @@
+#include "mix_simulator.h"
+
+#define MIXAL_SYMBOL_LENGTH 10   // longest symbol MIXAL accepts
+#define MIXAL_LINE_LENGTH 256    // longest source line we read
+
+typedef struct {
+    const char *name;  // mnemonic
+    int code;          // C field
+    int field;         // default F field
+} mix_opcode;
+
+static const mix_opcode opcodes[] = {
+    {"NOP", 0, 0},   {"ADD", 1, 5},   {"SUB", 2, 5},   {"MUL", 3, 5},   {"DIV", 4, 5},
+    {"NUM", 5, 0},   {"CHAR", 5, 1},  {"HLT", 5, 2},
+    {"SLA", 6, 0},   {"SRA", 6, 1},   {"SLAX", 6, 2},  {"SRAX", 6, 3},  {"SLC", 6, 4},  {"SRC", 6, 5},
+    {"MOVE", 7, 1},
+    {"LDA", 8, 5},   {"LD1", 9, 5},   {"LD2", 10, 5},  {"LD3", 11, 5},  {"LD4", 12, 5},
+    {"LD5", 13, 5},  {"LD6", 14, 5},  {"LDX", 15, 5},
+    {"LDAN", 16, 5}, {"LD1N", 17, 5}, {"LD2N", 18, 5}, {"LD3N", 19, 5}, {"LD4N", 20, 5},
+    {"LD5N", 21, 5}, {"LD6N", 22, 5}, {"LDXN", 23, 5},
+    {"STA", 24, 5},  {"ST1", 25, 5},  {"ST2", 26, 5},  {"ST3", 27, 5},  {"ST4", 28, 5},
+    {"ST5", 29, 5},  {"ST6", 30, 5},  {"STX", 31, 5},  {"STJ", 32, 2},  {"STZ", 33, 5},
+    {"JBUS", 34, 0}, {"IOC", 35, 0},  {"IN", 36, 0},   {"OUT", 37, 0},  {"JRED", 38, 0},
+    {"JMP", 39, 0},  {"JSJ", 39, 1},  {"JOV", 39, 2},  {"JNOV", 39, 3}, {"JL", 39, 4},
+    {"JE", 39, 5},   {"JG", 39, 6},   {"JGE", 39, 7},  {"JNE", 39, 8},  {"JLE", 39, 9},
+    {"JAN", 40, 0},  {"JAZ", 40, 1},  {"JAP", 40, 2},  {"JANN", 40, 3}, {"JANZ", 40, 4}, {"JANP", 40, 5},
+    {"J1N", 41, 0},  {"J1Z", 41, 1},  {"J1P", 41, 2},  {"J1NN", 41, 3}, {"J1NZ", 41, 4}, {"J1NP", 41, 5},
+    {"J2N", 42, 0},  {"J2Z", 42, 1},  {"J2P", 42, 2},  {"J2NN", 42, 3}, {"J2NZ", 42, 4}, {"J2NP", 42, 5},
+    {"J3N", 43, 0},  {"J3Z", 43, 1},  {"J3P", 43, 2},  {"J3NN", 43, 3}, {"J3NZ", 43, 4}, {"J3NP", 43, 5},
+    {"J4N", 44, 0},  {"J4Z", 44, 1},  {"J4P", 44, 2},  {"J4NN", 44, 3}, {"J4NZ", 44, 4}, {"J4NP", 44, 5},
+    {"J5N", 45, 0},  {"J5Z", 45, 1},  {"J5P", 45, 2},  {"J5NN", 45, 3}, {"J5NZ", 45, 4}, {"J5NP", 45, 5},
+    {"J6N", 46, 0},  {"J6Z", 46, 1},  {"J6P", 46, 2},  {"J6NN", 46, 3}, {"J6NZ", 46, 4}, {"J6NP", 46, 5},
+    {"JXN", 47, 0},  {"JXZ", 47, 1},  {"JXP", 47, 2},  {"JXNN", 47, 3}, {"JXNZ", 47, 4}, {"JXNP", 47, 5},
+    {"INCA", 48, 0}, {"DECA", 48, 1}, {"ENTA", 48, 2}, {"ENNA", 48, 3},
+    {"INC1", 49, 0}, {"DEC1", 49, 1}, {"ENT1", 49, 2}, {"ENN1", 49, 3},
+    {"INC2", 50, 0}, {"DEC2", 50, 1}, {"ENT2", 50, 2}, {"ENN2", 50, 3},
+    {"INC3", 51, 0}, {"DEC3", 51, 1}, {"ENT3", 51, 2}, {"ENN3", 51, 3},
+    {"INC4", 52, 0}, {"DEC4", 52, 1}, {"ENT4", 52, 2}, {"ENN4", 52, 3},
+    {"INC5", 53, 0}, {"DEC5", 53, 1}, {"ENT5", 53, 2}, {"ENN5", 53, 3},
+    {"INC6", 54, 0}, {"DEC6", 54, 1}, {"ENT6", 54, 2}, {"ENN6", 54, 3},
+    {"INCX", 55, 0}, {"DECX", 55, 1}, {"ENTX", 55, 2}, {"ENNX", 55, 3},
+    {"CMPA", 56, 5}, {"CMP1", 57, 5}, {"CMP2", 58, 5}, {"CMP3", 59, 5}, {"CMP4", 60, 5},
+    {"CMP5", 61, 5}, {"CMP6", 62, 5}, {"CMPX", 63, 5},
+};
+
+typedef struct {
+    char name[MIXAL_SYMBOL_LENGTH + 1];  // symbol text, empty for literal constants
+    int value;                           // equivalent once defined
+    int defined;                         // set once the symbol has a value
+    mix_word literal;                    // word to store for a literal constant
+    int isLiteral;                       // literal constants are placed at END like undefined symbols
+} mixal_symbol;
+
+typedef struct {
+    int address;  // instruction word waiting for the value
+    int symbol;   // index of the symbol it refers to
+} mixal_fixup;
+
+typedef struct {
+    mix_machine *machine;
+    mixal_symbol *symbols;  // every symbol and literal seen so far
+    int symbolCount;
+    int symbolCapacity;
+    int *slots;             // open-addressing index into symbols (-1 marks an empty slot)
+    int slotCapacity;
+    mixal_fixup *fixups;    // future references to resolve at END
+    int fixupCount;
+    int fixupCapacity;
+    int localBackward[10];  // last location of each local symbol dH (-1 if none yet)
+    int localForward[10];   // pending symbol index for dF references (-1 if none)
+    int location;           // location counter
+    int lineNumber;         // current source line, for error messages
+} mixal_assembler;
+
+static int fail(mixal_assembler *as, const char *message, const char *detail) {
+    snprintf(as->machine->error, sizeof(as->machine->error), "line %d: %s%s%s",
+             as->lineNumber, message, detail ? " " : "", detail ? detail : "");
+    return -1;
+}
+
+static mix_word make_word(long long value) {
+    if (value < 0) return MIX_SIGN_BIT | (mix_word)((-value) & MIX_MAGNITUDE_MASK);
+    return (mix_word)(value & MIX_MAGNITUDE_MASK);
+}
+
+static uint32_t hash_symbol(const char *name) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int add_symbol_entry(mixal_assembler *as, const char *name) {
+    if (as->symbolCount == as->symbolCapacity) {
+        as->symbolCapacity = as->symbolCapacity ? as->symbolCapacity * 2 : 64;
+        as->symbols = (mixal_symbol *)realloc(as->symbols, as->symbolCapacity * sizeof(mixal_symbol));
+    }
+    mixal_symbol *sym = &as->symbols[as->symbolCount];
+    memset(sym, 0, sizeof(*sym));
+    strncpy(sym->name, name, MIXAL_SYMBOL_LENGTH);
+    return as->symbolCount++;
+}
+
+static void grow_slots(mixal_assembler *as) {
+    int newCapacity = as->slotCapacity ? as->slotCapacity * 2 : 128;
+    int *newSlots = (int *)malloc(newCapacity * sizeof(int));
+    for (int i = 0; i < newCapacity; i++) newSlots[i] = -1;
+    for (int i = 0; i < as->slotCapacity; i++) {  // rehash named symbols
+        int index = as->slots[i];
+        if (index < 0) continue;
+        int slot = hash_symbol(as->symbols[index].name) & (newCapacity - 1);
+        while (newSlots[slot] >= 0) slot = (slot + 1) & (newCapacity - 1);
+        newSlots[slot] = index;
+    }
+    free(as->slots);
+    as->slots = newSlots;
+    as->slotCapacity = newCapacity;
+}
+
+// find a named symbol, creating an undefined entry when asked to
+static int lookup_symbol(mixal_assembler *as, const char *name, int create) {
+    if (as->slotCapacity == 0 || as->symbolCount * 2 >= as->slotCapacity) grow_slots(as);
+    int slot = hash_symbol(name) & (as->slotCapacity - 1);
+    while (as->slots[slot] >= 0) {
+        if (strcmp(as->symbols[as->slots[slot]].name, name) == 0) return as->slots[slot];
+        slot = (slot + 1) & (as->slotCapacity - 1);
+    }
+    if (!create) return -1;
+    int index = add_symbol_entry(as, name);
+    as->slots[slot] = index;
+    return index;
+}
+
+static int is_local_symbol(const char *name, char kind) {
+    return isdigit((unsigned char)name[0]) && name[1] == kind && name[2] == '\0';
+}
+
+static void add_fixup(mixal_assembler *as, int address, int symbolIndex) {
+    if (as->fixupCount == as->fixupCapacity) {
+        as->fixupCapacity = as->fixupCapacity ? as->fixupCapacity * 2 : 64;
+        as->fixups = (mixal_fixup *)realloc(as->fixups, as->fixupCapacity * sizeof(mixal_fixup));
+    }
+    as->fixups[as->fixupCount].address = address;
+    as->fixups[as->fixupCount].symbol = symbolIndex;
+    as->fixupCount++;
+}
+
+// parse one atom: a number, a defined symbol or '*'; *undefined gets the symbol index of a future reference
+static int parse_atom(mixal_assembler *as, const char **text, long long *value, int *undefined) {
+    const char *p = *text;
+    char token[MIXAL_SYMBOL_LENGTH + 2];
+    int length = 0;
+
+    if (*p == '*') {
+        *value = as->location;
+        *text = p + 1;
+        return 0;
+    }
+
+    int hasLetter = 0;
+    while (isalnum((unsigned char)p[length])) {
+        if (isalpha((unsigned char)p[length])) hasLetter = 1;
+        if (length > MIXAL_SYMBOL_LENGTH) return fail(as, "symbol or number too long", NULL);
+        token[length] = p[length];
+        length++;
+    }
+    token[length] = '\0';
+    if (length == 0) return fail(as, "expected a number or symbol in", *text);
+    *text = p + length;
+
+    if (!hasLetter) {
+        *value = strtoll(token, NULL, 10);
+        return 0;
+    }
+
+    if (is_local_symbol(token, 'B')) {
+        int backward = as->localBackward[token[0] - '0'];
+        if (backward < 0) return fail(as, "no earlier definition for", token);
+        *value = backward;
+        return 0;
+    }
+    if (is_local_symbol(token, 'F')) {
+        int digit = token[0] - '0';
+        if (as->localForward[digit] < 0) as->localForward[digit] = add_symbol_entry(as, "");
+        *undefined = as->localForward[digit];
+        *value = 0;
+        return 0;
+    }
+
+    int index = lookup_symbol(as, token, 1);
+    if (!as->symbols[index].defined) {
+        *undefined = index;
+        *value = 0;
+        return 0;
+    }
+    *value = as->symbols[index].value;
+    return 0;
+}
+
+// evaluate an expression with MIXAL's strict left-to-right operators + - * / // :
+static int parse_expression(mixal_assembler *as, const char **text, long long *value, int *undefined) {
+    const char *p = *text;
+    long long result = 0;
+    int sign = 1;
+    int atoms = 0;
+
+    if (*p == '+' || *p == '-') {
+        sign = *p == '-' ? -1 : 1;
+        p++;
+    }
+    if (parse_atom(as, &p, &result, undefined) < 0) return -1;
+    result *= sign;
+    atoms++;
+
+    for (;;) {
+        int op = 0;
+        if (p[0] == '/' && p[1] == '/') {
+            op = 'd';
+            p += 2;
+        } else if (*p == '+' || *p == '-' || *p == '*' || *p == '/' || *p == ':') {
+            op = *p++;
+        } else {
+            break;
+        }
+
+        long long operand = 0;
+        if (parse_atom(as, &p, &operand, undefined) < 0) return -1;
+        atoms++;
+        switch (op) {
+            case '+': result += operand; break;
+            case '-': result -= operand; break;
+            case '*': result *= operand; break;
+            case '/': result = operand ? result / operand : 0; break;
+            case 'd': result = operand ? (result << 30) / operand : 0; break;
+            case ':': result = 8 * result + operand; break;
+        }
+    }
+
+    if (*undefined >= 0 && (atoms > 1 || sign < 0)) {
+        return fail(as, "future reference must stand alone in", *text);
+    }
+    *text = p;
+    *value = result;
+    return 0;
+}
+
+// evaluate a W-value: E(F),E(F),... stored field by field into one word
+static int parse_wvalue(mixal_assembler *as, const char **text, mix_word *word) {
+    const char *p = *text;
+    mix_word result = 0;
+
+    for (;;) {
+        long long value = 0;
+        int undefined = -1;
+        if (parse_expression(as, &p, &value, &undefined) < 0) return -1;
+        if (undefined >= 0) return fail(as, "undefined symbol in W-value", as->symbols[undefined].name);
+
+        long long field = 5;
+        if (*p == '(') {
+            p++;
+            if (parse_expression(as, &p, &field, &undefined) < 0) return -1;
+            if (*p != ')') return fail(as, "missing ')' in", *text);
+            p++;
+        }
+
+        int left = (int)field / 8, right = (int)field % 8;
+        if (left > right || right > 5) return fail(as, "bad field specification in", *text);
+
+        mix_word converted = make_word(value);
+        if (left == 0) {  // the sign goes along with field (0:R)
+            result = (result & MIX_MAGNITUDE_MASK) | (converted & MIX_SIGN_BIT);
+            left = 1;
+        }
+        for (int byte = right; byte >= left; byte--) {  // copy rightmost bytes of the value into the field
+            int shift = 6 * (5 - byte);
+            int source = 6 * (right - byte);
+            result &= ~(63u << shift);
+            result |= ((converted >> source) & 63u) << shift;
+        }
+
+        if (*p != ',') break;
+        p++;
+    }
+
+    *text = p;
+    *word = result;
+    return 0;
+}
+
+static int find_opcode(const char *name) {
+    for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+        if (strcmp(opcodes[i].name, name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static int store_word(mixal_assembler *as, mix_word word) {
+    if (as->location < 0 || as->location >= MIX_MEMORY_SIZE) return fail(as, "location counter out of range", NULL);
+    as->machine->memory[as->location++] = word;
+    return 0;
+}
+
+// assemble "A,I(F)" for an instruction and store it
+static int assemble_instruction(mixal_assembler *as, const mix_opcode *op, const char *address) {
+    const char *p = address;
+    long long a = 0, index = 0, field = op->field;
+    int undefined = -1;
+
+    if (*p == '=') {  // literal constant: =W-value=
+        p++;
+        mix_word literal;
+        if (parse_wvalue(as, &p, &literal) < 0) return -1;
+        if (*p != '=') return fail(as, "unterminated literal in", address);
+        p++;
+        undefined = add_symbol_entry(as, "");
+        as->symbols[undefined].isLiteral = 1;
+        as->symbols[undefined].literal = literal;
+    } else if (*p != '\0' && *p != ',' && *p != '(') {
+        if (parse_expression(as, &p, &a, &undefined) < 0) return -1;
+    }
+
+    int ignored = -1;
+    if (*p == ',') {
+        p++;
+        if (parse_expression(as, &p, &index, &ignored) < 0) return -1;
+        if (ignored >= 0) return fail(as, "undefined symbol in index part", address);
+    }
+    if (*p == '(') {
+        p++;
+        if (parse_expression(as, &p, &field, &ignored) < 0) return -1;
+        if (ignored >= 0) return fail(as, "undefined symbol in field part", address);
+        if (*p != ')') return fail(as, "missing ')' in", address);
+        p++;
+    }
+    if (*p != '\0') return fail(as, "unexpected text in address", address);
+    if (a < -4095 || a > 4095) return fail(as, "address out of range in", address);
+    if (index < 0 || index > 6) return fail(as, "index out of range in", address);
+    if (field < 0 || field > 63) return fail(as, "field out of range in", address);
+
+    mix_word word = ((mix_word)(a < 0 ? -a : a) << 18) | ((mix_word)index << 12) | ((mix_word)field << 6) | (mix_word)op->code;
+    if (a < 0) word |= MIX_SIGN_BIT;
+    if (undefined >= 0) add_fixup(as, as->location, undefined);
+    return store_word(as, word);
+}
+
+static int define_label(mixal_assembler *as, const char *label, int value) {
+    if (label[0] == '\0') return 0;
+
+    if (isdigit((unsigned char)label[0]) && label[1] == 'H' && label[2] == '\0') {  // local symbol dH
+        int digit = label[0] - '0';
+        as->localBackward[digit] = value;
+        if (as->localForward[digit] >= 0) {  // resolve pending dF references
+            as->symbols[as->localForward[digit]].value = value;
+            as->symbols[as->localForward[digit]].defined = 1;
+            as->localForward[digit] = -1;
+        }
+        return 0;
+    }
+
+    int index = lookup_symbol(as, label, 1);
+    if (as->symbols[index].defined) return fail(as, "symbol defined twice:", label);
+    as->symbols[index].value = value;
+    as->symbols[index].defined = 1;
+    return 0;
+}
+
+// place undefined symbols and literals after the program, then patch every future reference
+static int finish_program(mixal_assembler *as) {
+    for (int i = 0; i < as->symbolCount; i++) {
+        mixal_symbol *sym = &as->symbols[i];
+        if (sym->defined) continue;
+        if (sym->name[0] == '\0' && !sym->isLiteral) continue;  // dF without a matching dH
+        sym->value = as->location;
+        sym->defined = 1;
+        if (store_word(as, sym->isLiteral ? sym->literal : 0) < 0) return -1;
+    }
+
+    for (int i = 0; i < as->fixupCount; i++) {
+        mixal_symbol *sym = &as->symbols[as->fixups[i].symbol];
+        if (!sym->defined) return fail(as, "unresolved local symbol", NULL);
+        mix_word *word = &as->machine->memory[as->fixups[i].address];
+        int value = sym->value;
+        *word &= ~(MIX_SIGN_BIT | (4095u << 18));  // clear sign and address bytes
+        *word |= (mix_word)(value < 0 ? -value : value) << 18;
+        if (value < 0) *word |= MIX_SIGN_BIT;
+    }
+    return 0;
+}
+
+// split "LABEL OP ADDRESS remarks" into its fields; returns 0 for comment or blank lines
+static int split_line(char *line, char **label, char **op, char **address) {
+    *label = *op = *address = "";
+    if (line[0] == '*' || line[0] == '\0') return 0;
+
+    char *p = line;
+    if (!isspace((unsigned char)*p)) {
+        *label = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if (*p) *p++ = '\0';
+    }
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '\0') return 0;
+    *op = p;
+    while (*p && !isspace((unsigned char)*p)) p++;
+    if (*p) *p++ = '\0';
+
+    if (strcmp(*op, "ALF") == 0) {  // ALF takes five characters verbatim
+        if (*p == ' ') p++;
+        if (*p == '"') p++;
+        *address = p;
+        return 1;
+    }
+
+    while (isspace((unsigned char)*p)) p++;
+    *address = p;
+    while (*p && !isspace((unsigned char)*p)) p++;
+    *p = '\0';
+    return 1;
+}
+
+int mix_assemble_file(mix_machine *machine, const char *path, int *start) {
+    FILE *source = fopen(path, "r");
+    if (source == NULL) {
+        snprintf(machine->error, sizeof(machine->error), "can not open %s", path);
+        return -1;
+    }
+
+    mixal_assembler as;
+    memset(&as, 0, sizeof(as));
+    as.machine = machine;
+    for (int i = 0; i < 10; i++) {
+        as.localBackward[i] = -1;
+        as.localForward[i] = -1;
+    }
+
+    char line[MIXAL_LINE_LENGTH];
+    int status = 0, ended = 0;
+    *start = 0;
+
+    while (status == 0 && !ended && fgets(line, sizeof(line), source) != NULL) {
+        as.lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char *label, *op, *address;
+        if (!split_line(line, &label, &op, &address)) continue;
+
+        const char *p = address;
+        mix_word word;
+        if (strcmp(op, "EQU") == 0) {
+            if ((status = parse_wvalue(&as, &p, &word)) == 0) {
+                int value = (int)(word & MIX_MAGNITUDE_MASK);
+                status = define_label(&as, label, (word & MIX_SIGN_BIT) ? -value : value);
+            }
+        } else if (strcmp(op, "ORIG") == 0) {
+            if ((status = define_label(&as, label, as.location)) == 0 && (status = parse_wvalue(&as, &p, &word)) == 0) {
+                as.location = (int)(word & MIX_MAGNITUDE_MASK);
+            }
+        } else if (strcmp(op, "CON") == 0) {
+            if ((status = define_label(&as, label, as.location)) == 0 && (status = parse_wvalue(&as, &p, &word)) == 0) {
+                status = store_word(&as, word);
+            }
+        } else if (strcmp(op, "ALF") == 0) {
+            word = 0;
+            for (int i = 0; i < 5; i++) {
+                char c = (p[0] && p[0] != '"') ? *p++ : ' ';
+                word |= (mix_word)mix_char_code(c) << (6 * (4 - i));
+            }
+            if ((status = define_label(&as, label, as.location)) == 0) status = store_word(&as, word);
+        } else if (strcmp(op, "END") == 0) {
+            if ((status = parse_wvalue(&as, &p, &word)) == 0) {
+                *start = (int)(word & MIX_MAGNITUDE_MASK);
+                if ((status = finish_program(&as)) == 0) status = define_label(&as, label, as.location);
+            }
+            ended = 1;
+        } else {
+            int opIndex = find_opcode(op);
+            if (opIndex < 0) {
+                status = fail(&as, "unknown operation", op);
+            } else if ((status = define_label(&as, label, as.location)) == 0) {
+                status = assemble_instruction(&as, &opcodes[opIndex], address);
+            }
+        }
+    }
+
+    if (status == 0 && !ended) status = fail(&as, "missing END", NULL);
+
+    fclose(source);
+    free(as.symbols);
+    free(as.slots);
+    free(as.fixups);
+    return status;
+}
@@ -0,0 +1,440 @@
+#include "mix_simulator.h"
+
+// words transferred by one IN/OUT on each device
+static const int blockSize[MIX_DEVICE_COUNT] = {
+    100, 100, 100, 100, 100, 100, 100, 100,  // tapes
+    100, 100, 100, 100, 100, 100, 100, 100,  // disks and drums
+    16, 16, 24, 14, 14                       // card reader, card punch, line printer, typewriter, paper tape
+};
+
+// nominal transfer time of one block in units (u); the device stays busy this long after IN/OUT
+static const int deviceLatency[MIX_DEVICE_COUNT] = {
+    500, 500, 500, 500, 500, 500, 500, 500,
+    300, 300, 300, 300, 300, 300, 300, 300,
+    1000, 2000, 1500, 2500, 1000
+};
+
+static const char *characters = " ABCDEFGHI~JKLMNOPQR[#STUVWXYZ0123456789.,()+-*/=$<>@;:'";
+
+int mix_char_code(char c) {
+    const char *found = strchr(characters, toupper((unsigned char)c));
+    return (found && c != '\0') ? (int)(found - characters) : 0;  // unknown characters read as blanks
+}
+
+char mix_char(int code) {
+    return (code >= 0 && code < 56) ? characters[code] : '?';
+}
+
+// word <-> signed value helpers
+static long long value_of(mix_word word) {
+    long long magnitude = word & MIX_MAGNITUDE_MASK;
+    return (word & MIX_SIGN_BIT) ? -magnitude : magnitude;
+}
+
+static mix_word with_sign(mix_word magnitude, int negative) {
+    return (magnitude & MIX_MAGNITUDE_MASK) | (negative ? MIX_SIGN_BIT : 0);
+}
+
+static int stop(mix_machine *machine, const char *message) {
+    snprintf(machine->error, sizeof(machine->error), "%s at location %d", message, machine->location);
+    return -1;
+}
+
+void mix_init(mix_machine *machine) {
+    memset(machine, 0, sizeof(*machine));
+    machine->stepLimit = MIX_DEFAULT_STEP_LIMIT;
+}
+
+void mix_free(mix_machine *machine) {
+    free(machine->output);
+    machine->output = NULL;
+    machine->outputLength = machine->outputCapacity = 0;
+}
+
+// contents of field (L:R) of a word, shifted right; the sign is kept only when L = 0
+static mix_word get_field(mix_word word, int left, int right) {
+    int negative = left == 0 && (word & MIX_SIGN_BIT);
+    if (left == 0) left = 1;
+    if (right < left) return negative ? MIX_SIGN_BIT : 0;
+    mix_word magnitude = (word & MIX_MAGNITUDE_MASK) >> (6 * (5 - right));
+    magnitude &= (1u << (6 * (right - left + 1))) - 1;
+    return with_sign(magnitude, negative);
+}
+
+// replace field (L:R) of a word with the rightmost bytes (and sign if L = 0) of a value
+static mix_word set_field(mix_word word, mix_word value, int left, int right) {
+    if (left == 0) {
+        word = (word & MIX_MAGNITUDE_MASK) | (value & MIX_SIGN_BIT);
+        left = 1;
+    }
+    if (right < left) return word;
+    int shift = 6 * (5 - right);
+    mix_word mask = ((1u << (6 * (right - left + 1))) - 1) << shift;
+    return (word & ~mask) | (((value & MIX_MAGNITUDE_MASK) << shift) & mask);
+}
+
+static mix_word read_memory(mix_machine *machine, int address) {
+    machine->touched[address] = 1;
+    return machine->memory[address];
+}
+
+static void write_memory(mix_machine *machine, int address, mix_word word) {
+    machine->touched[address] = 1;
+    machine->memory[address] = word;
+}
+
+static void append_output(mix_machine *machine, const char *record, size_t length) {
+    if (machine->outputLength + length + 2 > machine->outputCapacity) {
+        machine->outputCapacity = (machine->outputCapacity + length + 2) * 2;
+        machine->output = (char *)realloc(machine->output, machine->outputCapacity);
+    }
+    memcpy(machine->output + machine->outputLength, record, length);
+    machine->outputLength += length;
+    machine->output[machine->outputLength++] = '\n';
+    machine->output[machine->outputLength] = '\0';
+}
+
+// start an IN or OUT; waits first if the device is still busy with the previous block
+static int transfer(mix_machine *machine, int device, int address, int isInput) {
+    int words = blockSize[device];
+    if (address < 0 || address + words > MIX_MEMORY_SIZE) return stop(machine, "I/O buffer outside memory");
+    if (device < 16) return stop(machine, "tape and disk units are not simulated");
+
+    if (machine->time < machine->deviceReady[device]) {  // interlock: wait for the previous operation
+        machine->ioStall += machine->deviceReady[device] - machine->time;
+        machine->time = machine->deviceReady[device];
+    }
+    machine->deviceReady[device] = machine->time + deviceLatency[device];
+
+    if (isInput) {
+        char record[MIX_DEVICE_COUNT * 5 + 256] = "";
+        if (machine->input == NULL || fgets(record, sizeof(record), machine->input) == NULL) record[0] = '\0';
+        record[strcspn(record, "\r\n")] = '\0';
+        size_t length = strlen(record);
+        for (int w = 0; w < words; w++) {  // five characters per word, blank padded
+            mix_word word = 0;
+            for (int c = 0; c < 5; c++) {
+                size_t position = (size_t)(w * 5 + c);
+                word = (word << 6) | (mix_word)(position < length ? mix_char_code(record[position]) : 0);
+            }
+            write_memory(machine, address + w, word);
+        }
+    } else {
+        char record[100 * 5 + 1];
+        int length = 0;
+        for (int w = 0; w < words; w++) {
+            mix_word word = read_memory(machine, address + w);
+            for (int c = 0; c < 5; c++) record[length++] = mix_char((word >> (6 * (4 - c))) & 63);
+        }
+        while (length > 0 && record[length - 1] == ' ') length--;  // drop trailing blanks
+        append_output(machine, record, length);
+    }
+    return 0;
+}
+
+// execution time of an instruction in units, per Knuth's table
+static int instruction_time(int code, int field) {
+    switch (code) {
+        case 3: return 10;                 // MUL
+        case 4: return 12;                 // DIV
+        case 5: return 10;                 // NUM, CHAR, HLT
+        case 7: return 1 + 2 * field;      // MOVE
+        default:
+            if (code == 0) return 1;
+            if (code <= 2 || code == 6) return 2;
+            if (code >= 8 && code <= 33) return 2;
+            if (code >= 56) return 2;
+            return 1;                      // I/O, jumps, address transfers
+    }
+}
+
+static int register_is(long long value, int field) {
+    switch (field) {
+        case 0: return value < 0;
+        case 1: return value == 0;
+        case 2: return value > 0;
+        case 3: return value >= 0;
+        case 4: return value != 0;
+        case 5: return value <= 0;
+        default: return 0;
+    }
+}
+
+static mix_word *register_for(mix_machine *machine, int number) {
+    if (number == 0) return &machine->rA;
+    if (number == 7) return &machine->rX;
+    return &machine->rI[number];
+}
+
+static int step(mix_machine *machine) {
+    int location = machine->location;
+    if (location < 0 || location >= MIX_MEMORY_SIZE) return stop(machine, "program ran outside memory");
+
+    mix_word instruction = read_memory(machine, location);
+    int address = (int)((instruction >> 18) & 4095);
+    if (instruction & MIX_SIGN_BIT) address = -address;
+    int index = (instruction >> 12) & 63;
+    int field = (instruction >> 6) & 63;
+    int code = instruction & 63;
+
+    if (index > 6) return stop(machine, "invalid index register");
+    int m = address + (int)value_of(machine->rI[index]);
+    int left = field / 8, right = field % 8;
+    int next = location + 1;
+
+    machine->instructions++;
+    machine->time += instruction_time(code, field);
+
+    int needsMemory = (code >= 1 && code <= 4) || (code >= 8 && code <= 33) || (code >= 56);
+    if (needsMemory) {
+        if (m < 0 || m >= MIX_MEMORY_SIZE) return stop(machine, "memory address out of range");
+        if (code != 32 && (left > right || right > 5)) return stop(machine, "invalid field specification");
+    }
+
+    switch (code) {
+        case 0:  // NOP
+            break;
+        case 1:  // ADD
+        case 2: {  // SUB
+            long long operand = value_of(get_field(read_memory(machine, m), left, right));
+            long long result = value_of(machine->rA) + (code == 1 ? operand : -operand);
+            long long magnitude = result < 0 ? -result : result;
+            if (magnitude > MIX_MAGNITUDE_MASK) machine->overflow = 1;
+            int negative = result == 0 ? (machine->rA & MIX_SIGN_BIT) != 0 : result < 0;  // zero keeps the sign of rA
+            machine->rA = with_sign((mix_word)(magnitude & MIX_MAGNITUDE_MASK), negative);
+            break;
+        }
+        case 3: {  // MUL
+            mix_word operand = get_field(read_memory(machine, m), left, right);
+            uint64_t product = (uint64_t)(machine->rA & MIX_MAGNITUDE_MASK) * (operand & MIX_MAGNITUDE_MASK);
+            int negative = ((machine->rA ^ operand) & MIX_SIGN_BIT) != 0;
+            machine->rA = with_sign((mix_word)(product >> 30), negative);
+            machine->rX = with_sign((mix_word)(product & MIX_MAGNITUDE_MASK), negative);
+            break;
+        }
+        case 4: {  // DIV
+            mix_word operand = get_field(read_memory(machine, m), left, right);
+            uint64_t divisor = operand & MIX_MAGNITUDE_MASK;
+            uint64_t high = machine->rA & MIX_MAGNITUDE_MASK;
+            if (divisor == 0 || high >= divisor) {  // quotient would not fit
+                machine->overflow = 1;
+                break;
+            }
+            uint64_t dividend = (high << 30) | (machine->rX & MIX_MAGNITUDE_MASK);
+            int dividendNegative = (machine->rA & MIX_SIGN_BIT) != 0;
+            int negative = dividendNegative != ((operand & MIX_SIGN_BIT) != 0);
+            machine->rA = with_sign((mix_word)(dividend / divisor), negative);
+            machine->rX = with_sign((mix_word)(dividend % divisor), dividendNegative);
+            break;
+        }
+        case 5:
+            if (field == 0) {  // NUM: ten characters of rAX to a number
+                uint64_t number = 0;
+                for (int i = 0; i < 10; i++) {
+                    mix_word source = i < 5 ? machine->rA : machine->rX;
+                    int byte = (source >> (6 * (4 - i % 5))) & 63;
+                    number = number * 10 + byte % 10;
+                }
+                if (number > MIX_MAGNITUDE_MASK) machine->overflow = 1;
+                machine->rA = (machine->rA & MIX_SIGN_BIT) | (mix_word)(number & MIX_MAGNITUDE_MASK);
+            } else if (field == 1) {  // CHAR: number in rA to ten digit characters
+                uint64_t number = machine->rA & MIX_MAGNITUDE_MASK;
+                mix_word digits[2] = {0, 0};
+                for (int i = 9; i >= 0; i--) {
+                    digits[i / 5] |= (mix_word)(30 + number % 10) << (6 * (4 - i % 5));
+                    number /= 10;
+                }
+                machine->rA = (machine->rA & MIX_SIGN_BIT) | digits[0];
+                machine->rX = (machine->rX & MIX_SIGN_BIT) | digits[1];
+            } else if (field == 2) {  // HLT
+                machine->halted = 1;
+            } else {
+                return stop(machine, "invalid special operation");
+            }
+            break;
+        case 6: {  // shifts, counted in bytes
+            if (m < 0) return stop(machine, "negative shift amount");
+            uint64_t a = machine->rA & MIX_MAGNITUDE_MASK;
+            uint64_t x = machine->rX & MIX_MAGNITUDE_MASK;
+            uint64_t ax = (a << 30) | x;
+            int bits = 6 * (m > 10 ? 10 : m);
+            switch (field) {
+                case 0: a = bits >= 30 ? 0 : (a << bits) & MIX_MAGNITUDE_MASK; break;  // SLA
+                case 1: a = bits >= 30 ? 0 : a >> bits; break;                         // SRA
+                case 2: ax = bits >= 60 ? 0 : (ax << bits) & ((1ULL << 60) - 1); break; // SLAX
+                case 3: ax = bits >= 60 ? 0 : ax >> bits; break;                        // SRAX
+                case 4: case 5: {  // SLC, SRC rotate the ten bytes
+                    int rotate = 6 * (m % 10);
+                    if (field == 5) rotate = (60 - rotate) % 60;
+                    if (rotate) ax = ((ax << rotate) | (ax >> (60 - rotate))) & ((1ULL << 60) - 1);
+                    break;
+                }
+                default: return stop(machine, "invalid shift");
+            }
+            if (field >= 2) {
+                a = ax >> 30;
+                x = ax & MIX_MAGNITUDE_MASK;
+            }
+            machine->rA = (machine->rA & MIX_SIGN_BIT) | (mix_word)a;
+            machine->rX = (machine->rX & MIX_SIGN_BIT) | (mix_word)x;
+            break;
+        }
+        case 7: {  // MOVE F words from M to the address in rI1
+            int target = (int)value_of(machine->rI[1]);
+            for (int i = 0; i < field; i++) {
+                if (m + i >= MIX_MEMORY_SIZE || target + i < 0 || target + i >= MIX_MEMORY_SIZE) {
+                    return stop(machine, "MOVE outside memory");
+                }
+                write_memory(machine, target + i, read_memory(machine, m + i));
+            }
+            machine->rI[1] = with_sign((mix_word)(target + field < 0 ? -(target + field) : target + field), target + field < 0);
+            break;
+        }
+        default:
+            if (code >= 8 && code <= 23) {  // loads, LDxN negates
+                int number = (code - 8) % 8;
+                mix_word value = get_field(read_memory(machine, m), left, right);
+                if (code >= 16) value ^= MIX_SIGN_BIT;
+                if (number >= 1 && number <= 6 && (value & MIX_MAGNITUDE_MASK) > 4095) {
+                    return stop(machine, "index register overflow");
+                }
+                *register_for(machine, number) = value;
+            } else if (code >= 24 && code <= 31) {  // stores
+                mix_word value = *register_for(machine, code - 24);
+                write_memory(machine, m, set_field(read_memory(machine, m), value, left, right));
+            } else if (code == 32) {  // STJ
+                write_memory(machine, m, set_field(read_memory(machine, m), machine->rJ, left, right));
+            } else if (code == 33) {  // STZ
+                write_memory(machine, m, set_field(read_memory(machine, m), 0, left, right));
+            } else if (code >= 34 && code <= 38) {  // I/O
+                if (field >= MIX_DEVICE_COUNT) return stop(machine, "invalid device");
+                int busy = machine->time < machine->deviceReady[field];
+                if (code == 34 && busy) {  // JBUS
+                    machine->rJ = (mix_word)next;
+                    next = m;
+                    if (m == location) {  // JBUS * spins one unit per pass, skip straight to the last pass
+                        long long remaining = machine->deviceReady[field] - machine->time - 1;
+                        machine->instructions += remaining;
+                        machine->time += remaining;
+                        machine->ioStall += remaining + 1;
+                    }
+                } else if (code == 38 && !busy) {  // JRED
+                    machine->rJ = (mix_word)next;
+                    next = m;
+                } else if (code == 36 || code == 37) {
+                    if (transfer(machine, field, m, code == 36) < 0) return -1;
+                }  // IOC only controls positioning, nothing to model
+            } else if (code == 39) {  // JMP and comparison jumps
+                int cmp = machine->comparison;
+                int jump = 0;
+                switch (field) {
+                    case 0: case 1: jump = 1; break;
+                    case 2: jump = machine->overflow; machine->overflow = 0; break;
+                    case 3: jump = !machine->overflow; machine->overflow = 0; break;
+                    case 4: jump = cmp < 0; break;
+                    case 5: jump = cmp == 0; break;
+                    case 6: jump = cmp > 0; break;
+                    case 7: jump = cmp >= 0; break;
+                    case 8: jump = cmp != 0; break;
+                    case 9: jump = cmp <= 0; break;
+                    default: return stop(machine, "invalid jump");
+                }
+                if (jump) {
+                    if (field != 1) machine->rJ = (mix_word)next;  // JSJ leaves rJ alone
+                    next = m;
+                }
+            } else if (code >= 40 && code <= 47) {  // register jumps
+                if (field > 5) return stop(machine, "invalid register jump");
+                if (register_is(value_of(*register_for(machine, code - 40)), field)) {
+                    machine->rJ = (mix_word)next;
+                    next = m;
+                }
+            } else if (code >= 48 && code <= 55) {  // INC, DEC, ENT, ENN
+                int number = code - 48;
+                mix_word *reg = register_for(machine, number);
+                long long result;
+                int negative;
+                if (field == 2 || field == 3) {  // ENT/ENN take M, with the instruction sign when M is zero
+                    result = field == 2 ? m : -m;
+                    negative = m == 0 ? ((instruction & MIX_SIGN_BIT) != 0) != (field == 3) : result < 0;
+                } else if (field <= 1) {
+                    result = value_of(*reg) + (field == 0 ? m : -m);
+                    negative = result == 0 ? (*reg & MIX_SIGN_BIT) != 0 : result < 0;
+                } else {
+                    return stop(machine, "invalid address transfer");
+                }
+                long long magnitude = result < 0 ? -result : result;
+                if (number >= 1 && number <= 6) {
+                    if (magnitude > 4095) return stop(machine, "index register overflow");
+                } else if (magnitude > MIX_MAGNITUDE_MASK) {
+                    machine->overflow = 1;
+                }
+                *reg = with_sign((mix_word)(magnitude & MIX_MAGNITUDE_MASK), negative);
+            } else if (code >= 56 && code <= 63) {  // CMP
+                long long registerValue = value_of(get_field(*register_for(machine, code - 56), left, right));
+                long long memoryValue = value_of(get_field(read_memory(machine, m), left, right));
+                machine->comparison = (registerValue > memoryValue) - (registerValue < memoryValue);
+            } else {
+                return stop(machine, "invalid operation code");
+            }
+            break;
+    }
+
+    machine->location = next;
+    return 0;
+}
+
+int mix_run(mix_machine *machine, int start) {
+    machine->location = start;
+    while (!machine->halted) {
+        if (machine->instructions >= machine->stepLimit) return stop(machine, "step limit reached");
+        if (step(machine) < 0) return -1;
+    }
+    for (int device = 0; device < MIX_DEVICE_COUNT; device++) {  // the program ends when its output is done
+        if (machine->deviceReady[device] > machine->time) machine->time = machine->deviceReady[device];
+    }
+    return 0;
+}
+
+int mix_instruction_time(mix_word instruction) {
+    return instruction_time(instruction & 63, (instruction >> 6) & 63);
+}
+
+int mix_memory_touched(const mix_machine *machine) {
+    int count = 0;
+    for (int i = 0; i < MIX_MEMORY_SIZE; i++) count += machine->touched[i];
+    return count;
+}
+
+int mix_output_values(const mix_machine *machine, int *values, int maxValues) {
+    int count = 0;
+    const char *line = machine->output;
+    while (line != NULL && *line != '\0' && count < maxValues) {
+        const char *p = line;
+        while (count < maxValues) {  // a line printer record holds several values side by side
+            while (*p == ' ') p++;
+            int negative = *p == '-';
+            if (*p == '+' || *p == '-') p++;
+            if (!isdigit((unsigned char)*p)) break;
+            char *end;
+            values[count++] = (int)strtol(p, &end, 10) * (negative ? -1 : 1);
+            p = end;
+        }
+        line = strchr(line, '\n');
+        if (line != NULL) line++;
+    }
+    return count;
+}
+
+void mix_print_report(FILE *logFile, const mix_machine *machine) {
+    fprintf(logFile, "\nMIX SIMULATION\n--------------\n");
+    if (machine->output != NULL) {
+        fprintf(logFile, "%s", machine->output);  // every printed record, in order
+    }
+    if (machine->error[0] != '\0') {
+        fprintf(logFile, "Error: %s\n", machine->error);
+    }
+    fprintf(logFile, "Time: %lld u (%lld u waiting for devices)\n", machine->time, machine->ioStall);
+    fprintf(logFile, "Instructions: %lld\n", machine->instructions);
+    fprintf(logFile, "Memory words touched: %d\n", mix_memory_touched(machine));
+}
@@ -0,0 +1,55 @@
+#ifndef MIX_SIMULATOR_H
+#define MIX_SIMULATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define MIX_MEMORY_SIZE 4000            // words of MIX memory
+#define MIX_DEVICE_COUNT 21             // tapes 0-7, disks 8-15, card reader 16, punch 17, printer 18, typewriter 19, paper tape 20
+#define MIX_SIGN_BIT (1u << 30)         // sign of a word, bits 0-29 hold five 6-bit bytes
+#define MIX_MAGNITUDE_MASK (MIX_SIGN_BIT - 1)
+#define MIX_DEFAULT_STEP_LIMIT 100000000 // instructions executed before giving up
+
+typedef uint32_t mix_word;  // sign bit plus five bytes of 6 bits
+
+typedef struct mix_machine_tag {
+    mix_word memory[MIX_MEMORY_SIZE];
+    mix_word rA;                 // accumulator
+    mix_word rX;                 // extension register
+    mix_word rI[7];              // index registers rI1-rI6 (slot 0 is always zero)
+    mix_word rJ;                 // jump register
+    int overflow;                // overflow toggle
+    int comparison;              // comparison indicator: -1 less, 0 equal, 1 greater
+    int location;                // address of the next instruction
+    int halted;                  // set once HLT executes
+
+    long long time;              // elapsed time in Knuth's units (u)
+    long long instructions;      // instructions executed
+    long long ioStall;           // units spent waiting for busy devices
+    long long stepLimit;         // maximum number of instructions to execute
+    long long deviceReady[MIX_DEVICE_COUNT];  // time at which each device becomes ready
+    unsigned char touched[MIX_MEMORY_SIZE];   // words fetched, read or written
+
+    FILE *input;                 // records for input devices, NULL reads blank records
+    char *output;                // records written to character devices, one line each
+    size_t outputLength;
+    size_t outputCapacity;
+
+    char error[160];             // reason the assembler or the machine stopped
+} mix_machine;
+
+void mix_init(mix_machine *machine);  // clear memory, registers and counters
+int mix_assemble_file(mix_machine *machine, const char *path, int *start);  // load a MIXAL program, 0 on success
+int mix_run(mix_machine *machine, int start);  // execute until HLT, 0 on success
+int mix_memory_touched(const mix_machine *machine);  // number of distinct words referenced
+int mix_instruction_time(mix_word instruction);  // units one execution of an assembled instruction takes
+int mix_output_values(const mix_machine *machine, int *values, int maxValues);  // numbers printed by the program
+void mix_print_report(FILE *logFile, const mix_machine *machine);  // output and timing summary
+void mix_free(mix_machine *machine);  // release the output buffer
+int mix_char_code(char c);  // MIX character code of an ASCII character
+char mix_char(int code);  // ASCII character for a MIX character code
+
+#endif
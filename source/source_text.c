@@ -0,0 +1,76 @@
+#include "source_text.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// reserve zeroed pages for the text and its padding, then map the file over the front of them:
+// the padding is zero even when the file ends exactly on a page boundary
+static int map_file(int fd, size_t length, source_text *text) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t bytes = (length + SOURCE_PADDING + page - 1) / page * page;
+    char *base = (char *)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return -1;
+
+    // private and writable: the scanner briefly writes a NUL after each token, the file never sees it
+    if (mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, bytes);
+        return -1;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);  // read once, front to back
+
+    text->data = base;
+    text->length = length;
+    text->mappedBytes = bytes;
+    return 0;
+}
+
+static int read_stream(FILE *file, source_text *text) {
+    size_t capacity = 64 * 1024;
+    text->data = (char *)malloc(capacity);
+    text->length = 0;
+    text->mappedBytes = 0;
+    size_t got;
+    while ((got = fread(text->data + text->length, 1, capacity - SOURCE_PADDING - text->length, file)) > 0) {
+        text->length += got;
+        if (text->length == capacity - SOURCE_PADDING) {
+            capacity *= 2;
+            text->data = (char *)realloc(text->data, capacity);
+        }
+    }
+    memset(text->data + text->length, 0, SOURCE_PADDING);
+    return ferror(file) ? -1 : 0;
+}
+
+int load_source_stream(FILE *file, source_text *text) {
+    int fd = fileno(file);
+    struct stat info;
+    // a regular file read from its start can be mapped; pipes, terminals and empty files are read
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0 &&
+        map_file(fd, (size_t)info.st_size, text) == 0) {
+        return 0;
+    }
+    return read_stream(file, text);
+}
+
+int load_source_file(const char *path, source_text *text) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        text->data = NULL;
+        text->length = 0;
+        text->mappedBytes = 0;
+        return -1;
+    }
+    int result = load_source_stream(file, text);
+    fclose(file);  // a mapping stays valid after the descriptor is closed
+    return result;
+}
+
+void free_source_text(source_text *text) {
+    if (text->mappedBytes > 0) {
+        munmap(text->data, text->mappedBytes);
+    } else {
+        free(text->data);
+    }
+    memset(text, 0, sizeof(*text));
+}
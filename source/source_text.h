@@ -0,0 +1,20 @@
+#ifndef SOURCE_TEXT_H
+#define SOURCE_TEXT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_PADDING 2  // NUL bytes after the text; flex scans a buffer in place only when it ends in two
+
+typedef struct {
+    char *data;          // the text followed by SOURCE_PADDING zero bytes, writable
+    size_t length;       // bytes of text
+    size_t mappedBytes;  // size of the mapping when the file is memory-mapped, 0 when data is malloc'd
+} source_text;
+
+int load_source_file(const char *path, source_text *text);  // map or read a whole file, 0 on success
+int load_source_stream(FILE *file, source_text *text);  // map a regular file, read anything else to the end, 0 on success
+void free_source_text(source_text *text);
+
+#endif
@@ -0,0 +1,76 @@
+#include "compile_stats.h"
+
+#include <sys/resource.h>
+
+static const char *phaseNames[PHASE_COUNT] = {
+    "lex", "parse", "print_tree", "interpret", "fold", "codegen", "simulate", "cache"
+};
+
+static const char *counterNames[COUNTER_COUNT] = {
+    "tokens", "nodes", "symbol_lookups", "interpreter_steps", "instructions_emitted", "instructions_written", "arena_bytes", "memory_words",
+    "cache_hits", "cache_misses", "peak_rss_kb"
+};
+
+long long stats_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+long long stats_peak_kilobytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (long long)usage.ru_maxrss;  // kilobytes on Linux
+}
+
+void stats_add_time(compile_stats *stats, compile_phase phase, long long started) {
+    stats->phaseNanoseconds[phase] += stats_clock() - started;
+}
+
+void print_stats_text(FILE *file, const compile_stats *stats) {
+    long long total = 0;
+    fprintf(file, "\nSTATISTICS\n----------\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(file, "%-12s %10.3f ms\n", phaseNames[i], stats->phaseNanoseconds[i] / 1e6);
+        total += stats->phaseNanoseconds[i];
+    }
+    fprintf(file, "%-12s %10.3f ms\n", "total", total / 1e6);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fprintf(file, "%-21s %lld\n", counterNames[i], stats->counters[i]);
+    }
+}
+
+// source paths go into a JSON string, escape what JSON requires
+static void write_json_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const char *p = text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') fputc('\\', file);
+        if ((unsigned char)*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+            continue;
+        }
+        fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+int write_stats_json(const char *path, const char *source, const compile_stats *stats) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening statistics file %s!\n", path);
+        return -1;
+    }
+
+    fprintf(file, "{\"source\": ");
+    write_json_string(file, source);
+    fprintf(file, ", \"phases_ns\": {");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(file, "%s\"%s\": %lld", i ? ", " : "", phaseNames[i], stats->phaseNanoseconds[i]);
+    }
+    fprintf(file, "}, \"counters\": {");
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fprintf(file, "%s\"%s\": %lld", i ? ", " : "", counterNames[i], stats->counters[i]);
+    }
+    fprintf(file, "}}\n");
+    return fclose(file) == 0 ? 0 : -1;
+}
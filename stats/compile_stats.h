@@ -0,0 +1,67 @@
+#ifndef COMPILE_STATS_H
+#define COMPILE_STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_NONE 0     // no trace lines in the log
+#define TRACE_PARSER 1   // "Bison:" reductions
+#define TRACE_TOKENS 2   // "Lex:" tokens as well
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_TOKENS  // highest level compiled in; build with -DTRACE_LEVEL=0 to remove every trace call
+#endif
+
+// log a trace line when both the compiled-in and the run-time level allow it; context needs logFile and traceLevel
+#define TRACE(context, level, ...) \
+    do { \
+        if ((level) <= TRACE_LEVEL && (level) <= (context)->traceLevel) fprintf((context)->logFile, __VA_ARGS__); \
+    } while (0)
+
+typedef enum {
+    PHASE_LEX,        // scanning, measured inside the parse
+    PHASE_PARSE,      // grammar actions and tree building, without the scanner
+    PHASE_PRINT_TREE, // syntax tree dump to the log
+    PHASE_INTERPRET,  // expand_node: bytecode lowering and execution
+    PHASE_FOLD,       // constant folding, control-flow graph and dead code elimination
+    PHASE_CODEGEN,    // generate_mix_code: instruction list, peephole, write
+    PHASE_SIMULATE,   // --simulate
+    PHASE_CACHE,      // --cache-dir: hashing the source, lookup and storing the artifacts
+    PHASE_COUNT
+} compile_phase;
+
+typedef enum {
+    COUNTER_TOKENS,               // tokens returned by the scanner
+    COUNTER_NODES,                // syntax tree nodes created
+    COUNTER_SYMBOL_LOOKUPS,       // find_symbol calls
+    COUNTER_INTERPRETER_STEPS,    // bytecode instructions executed by expand_node
+    COUNTER_INSTRUCTIONS_EMITTED, // MIX instructions generated before the peephole pass
+    COUNTER_INSTRUCTIONS_WRITTEN, // MIX instructions left in the mixal file
+    COUNTER_ARENA_BYTES,          // bytes handed out by the tree arena
+    COUNTER_MEMORY_WORDS,         // MIX words used by data, code and literals
+    COUNTER_CACHE_HITS,           // compilations answered from --cache-dir
+    COUNTER_CACHE_MISSES,         // compilations that ran and were then stored
+    COUNTER_PEAK_KILOBYTES,       // peak resident memory of the process so far
+    COUNTER_COUNT
+} compile_counter;
+
+typedef enum {
+    STATS_OFF,   // nothing is measured
+    STATS_TEXT,  // STATISTICS section at the end of the log
+    STATS_JSON   // one JSON object per compilation
+} stats_format;
+
+typedef struct {
+    long long phaseNanoseconds[PHASE_COUNT];
+    long long counters[COUNTER_COUNT];
+} compile_stats;
+
+long long stats_clock(void);  // monotonic time in nanoseconds
+long long stats_peak_kilobytes(void);  // largest resident set of the process, shared by every thread
+void stats_add_time(compile_stats *stats, compile_phase phase, long long started);  // charge the time since started to phase
+void print_stats_text(FILE *file, const compile_stats *stats);  // human-readable summary
+int write_stats_json(const char *path, const char *source, const compile_stats *stats);  // machine-readable report, 0 on success
+
+#endif
@@ -3,24 +3,116 @@
 #include "syntax_tree/syntax_tree.h"
 #include "syntax_tree/node_types.h"
 #include "mixal/mix_codegen.h"
+#include "simulator/mix_simulator.h"
+#include "interpreter/bytecode.h"
+#include "optimizer/const_fold.h"
+#include "optimizer/cfg.h"
+#include "optimizer/dead_code.h"
+#include "optimizer/partial_eval.h"
+#include "optimizer/value_number.h"
+#include "optimizer/loops.h"
+#include "cache/compile_cache.h"
+#include "profile/line_profile.h"
+#include "source/source_text.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-FILE *logFile;                // file pointer for logging
-struct TreeNode *root = NULL;  // pointer to the root of the syntax tree
-symbol *symbolList = NULL;     // pointer to the head of the symbol list
+%}
 
-void yyerror(const char *s);   // function to handle parsing errors
-int yylex(void);               // function to perform lexical analysis
-void expand_node(struct TreeNode *node);  // function to evaluate and expand the syntax tree
+%code requires {
+#include "compiler/compiler_context.h"
+}
 
-%}
+%code {
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, void *scanner, compiler_context *context);  // function to perform lexical analysis
+int scan_token(YYSTYPE *yylval, YYLTYPE *yylloc, void *scanner);  // the reentrant flex scanner behind yylex, which also sets the token's line
+// write a blob to path, or to stdout without one
+static int write_artifact(const char *path, const cache_blob *blob) {
+    FILE *file = path != NULL ? fopen(path, "wb") : stdout;
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s!\n", path);
+        return -1;
+    }
+    int failed = blob->length > 0 && fwrite(blob->data, 1, blob->length, file) != blob->length;
+    if (file != stdout && fclose(file) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
+
+// the MIXAL is the output itself, or a listing next to an image or deck
+static int writes_listing(const compiler_options *options) {
+    return options->emitFormat == EMIT_MIXAL || options->listing;
+}
+
+int replay_cached(compiler_context *context, const cache_entry *entry) {
+    context->logFile = fopen(context->logPath, "w");  // left open so the statistics can follow
+    if (context->logFile == NULL) {
+        fprintf(stderr, "Error opening log file %s!\n", context->logPath);
+        return -1;
+    }
+    fwrite(entry->log.data, 1, entry->log.length, context->logFile);
+    if (writes_listing(&context->options) && write_artifact(context->mixalPath, &entry->mixal) != 0) return -1;
+    if (write_artifact(context->mapPath, &entry->lines) != 0) return -1;
+    if (context->imagePath != NULL && write_artifact(context->imagePath, &entry->image) != 0) return -1;
+    return write_artifact(context->outputPath, &entry->output);
+}
+
+void store_cached(compiler_context *context, const cache_blob *key, cache_blob *output) {
+    fclose(context->outputFile);  // completes output
+    context->outputFile = NULL;
+    write_artifact(context->outputPath, output);  // the program output was held back until now
+    if (context->failed) return;  // errors went to stderr, which a hit could not repeat
+
+    cache_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    fflush(context->logFile);
+    if (cache_read_file(context->logPath, &entry.log) == 0 && cache_read_file(context->mapPath, &entry.lines) == 0 &&
+        (!writes_listing(&context->options) || cache_read_file(context->mixalPath, &entry.mixal) == 0) &&
+        (context->imagePath == NULL || cache_read_file(context->imagePath, &entry.image) == 0)) {
+        entry.output = *output;
+        cache_store(context->options.cacheDirectory, context->options.cacheMaxBytes, key, &entry);
+        entry.output.data = NULL;  // still owned by the caller
+    }
+    cache_entry_free(&entry);
+}
+
+void report_stats(compiler_context *context) {
+    context->stats.counters[COUNTER_PEAK_KILOBYTES] = stats_peak_kilobytes();
+    if (context->options.statsFormat == STATS_TEXT) {
+        print_stats_text(context->logFile, &context->stats);
+    } else if (context->options.statsFormat == STATS_JSON) {
+        write_stats_json(context->statsPath, context->inputPath != NULL ? context->inputPath : "-", &context->stats);
+    }
+}
+
+void yyerror(YYLTYPE *yylloc, void *scanner, compiler_context *context, const char *s);  // function to handle parsing errors
+int yylex_init_extra(compiler_context *context, void **scanner);  // scanner entry points generated by flex
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size, void *scanner);  // scan text in place, it must end in two NUL bytes
+int yylex_destroy(void *scanner);
+void expand_node(compiler_context *context, struct TreeNode *node);  // function to evaluate the program at compile time
+void record_write(void *user, int value);  // function to remember a value printed by expand_node
+void simulate_program(compiler_context *context, const mix_image *image);  // function to run the assembled program on the simulator
+int replay_cached(compiler_context *context, const cache_entry *entry);  // function to write the artifacts of a cache hit
+void store_cached(compiler_context *context, const cache_blob *key, cache_blob *output);  // function to publish the artifacts of a compile
+void report_stats(compiler_context *context);  // function to write the statistics in the chosen format
+TreeNode *new_node(compiler_context *context, int line, NodeType type, TreeNode *left, TreeNode *right, const char *value);  // counted create_node at a source line
+
+// a rule starts on the line of its first symbol; the location is only the line number
+#define YYLLOC_DEFAULT(Current, Rhs, N) ((Current) = (N) ? YYRHSLOC(Rhs, 1) : YYRHSLOC(Rhs, 0))
+}
+
+%define api.pure full
+%define api.location.type {int}
+%locations
+%initial-action { @$ = 1; }  // an empty source fails on its first line
+%parse-param {void *scanner} {compiler_context *context}
+%lex-param {void *scanner} {compiler_context *context}
 
 %union {
     int yint;                  // integer value
-    char ystr[100];            // string value
+    const char *ystr;          // interned string value
     struct TreeNode* node;     // tree node pointer
 }
 
@@ -35,20 +127,26 @@ void expand_node(struct TreeNode *node);  // function to evaluate and expand the
 
 program:
     stmt_seq { 
-        $$ = create_node(NODE_PROGRAM, $1, NULL, NULL);
-        root = $$;  // program node as the roof of ast
-        fprintf(logFile, "Bison: Parsed program\n"); 
+        $$ = new_node(context, @$, NODE_PROGRAM, $1, NULL, NULL);
+        context->root = $$;  // program node as the roof of ast
+        TRACE(context, TRACE_PARSER, "Bison: Parsed program\n"); 
     }
     ;
 
 stmt_seq:
     stmt_seq SEMICOLON stmt {
-        $$ = create_node(NODE_SEQ, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created stmt_seq with ';'\n"); 
+        if ($1->type == NODE_SEQ) {
+            $$ = $1;  // a statement is never a sequence, so this is the list being built
+        } else {
+            $$ = create_sequence(&context->astArena, $1);
+            context->stats.counters[COUNTER_NODES]++;
+        }
+        append_statement(&context->astArena, $$, $3);  // one flat vector instead of a nested SEQ per ';'
+        TRACE(context, TRACE_PARSER, "Bison: Created stmt_seq with ';'\n"); 
     }
     | stmt {
         $$ = $1;
-        fprintf(logFile, "Bison: Created stmt_seq with stmt\n"); 
+        TRACE(context, TRACE_PARSER, "Bison: Created stmt_seq with stmt\n"); 
     }
     ;
 
@@ -62,194 +160,412 @@ stmt:
 
 assign_stmt:
     ID AS exp {
-        $$ = create_node(NODE_ASSIGNMENT, create_node(NODE_ID, NULL, NULL, $1), $3, NULL); 
-        fprintf(logFile, "Bison: Created assign_stmt\n");
+        $$ = new_node(context, @$, NODE_ASSIGNMENT, new_node(context, @1, NODE_ID, NULL, NULL, $1), $3, NULL); 
+        TRACE(context, TRACE_PARSER, "Bison: Created assign_stmt\n");
     }
     ;
 
 read_stmt:
     READ ID {
-        $$ = create_node(NODE_READ, NULL, NULL, strdup($2)); 
-        fprintf(logFile, "Bison: Created read_stmt\n");
+        $$ = new_node(context, @$, NODE_READ, NULL, NULL, $2); 
+        TRACE(context, TRACE_PARSER, "Bison: Created read_stmt\n");
     }
     ;
 
 write_stmt:
     WRITE ID {
-        $$ = create_node(NODE_WRITE, NULL, NULL, strdup($2)); 
-        fprintf(logFile, "Bison: Created write_stmt\n");
+        $$ = new_node(context, @$, NODE_WRITE, NULL, NULL, $2); 
+        TRACE(context, TRACE_PARSER, "Bison: Created write_stmt\n");
     }
     ;
 
 if_stmt:
     IF exp THEN stmt_seq END {
-        $$ = create_node(NODE_IF, $2, $4, NULL); 
-        fprintf(logFile, "Bison: Created if_stmt\n");
+        $$ = new_node(context, @$, NODE_IF, $2, $4, NULL); 
+        TRACE(context, TRACE_PARSER, "Bison: Created if_stmt\n");
     }
     | IF exp THEN stmt_seq ELSE stmt_seq END {
-        $$ = create_node(NODE_IF, $2, create_node(NODE_ELSE, $4, $6, NULL), NULL); 
-        fprintf(logFile, "Bison: Created if-else stmt\n");
+        $$ = new_node(context, @$, NODE_IF, $2, new_node(context, @5, NODE_ELSE, $4, $6, NULL), NULL); 
+        TRACE(context, TRACE_PARSER, "Bison: Created if-else stmt\n");
     }
     ;
 
 repeat_stmt:
     REPEAT stmt_seq UNTIL exp {
-        $$ = create_node(NODE_REPEAT, $2, $4, NULL); 
-        fprintf(logFile, "Bison: Created repeat_stmt\n");
+        $$ = new_node(context, @$, NODE_REPEAT, $2, $4, NULL); 
+        TRACE(context, TRACE_PARSER, "Bison: Created repeat_stmt\n");
     }
     ;
 
 exp:
     rel_exp {
         $$ = $1;
-        fprintf(logFile, "Bison: Parsed exp\n");
+        TRACE(context, TRACE_PARSER, "Bison: Parsed exp\n");
     }
     ;
 
 rel_exp:
     simple_exp
     | rel_exp LT simple_exp {
-        $$ = create_node(NODE_LT, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created rel_exp with '<'\n");
+        $$ = new_node(context, @$, NODE_LT, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created rel_exp with '<'\n");
     }
     | rel_exp EQ simple_exp {
-        $$ = create_node(NODE_EQ, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created rel_exp with '='\n");
+        $$ = new_node(context, @$, NODE_EQ, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created rel_exp with '='\n");
     }
     ;
 
 simple_exp:
     term
     | simple_exp PLUS term {
-        $$ = create_node(NODE_ADD, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created simple_exp with '+'\n");
+        $$ = new_node(context, @$, NODE_ADD, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created simple_exp with '+'\n");
     }
     | simple_exp MINUS term {
-        $$ = create_node(NODE_SUBTRACT, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created simple_exp with '-'\n");
+        $$ = new_node(context, @$, NODE_SUBTRACT, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created simple_exp with '-'\n");
     }
     ;
 
 term:
     factor
     | term TIMES factor {
-        $$ = create_node(NODE_MULTIPLY, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created term with '*'\n");
+        $$ = new_node(context, @$, NODE_MULTIPLY, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created term with '*'\n");
     }
     | term DIVIDE factor {
-        $$ = create_node(NODE_DIVIDE, $1, $3, NULL);  
-        fprintf(logFile, "Bison: Created term with '/'\n");
+        $$ = new_node(context, @$, NODE_DIVIDE, $1, $3, NULL);  
+        TRACE(context, TRACE_PARSER, "Bison: Created term with '/'\n");
     }
     ;
 
 factor:
     LPAREN exp RPAREN { 
         $$ = $2;
-        fprintf(logFile, "Bison: Created factor with parentheses\n");
+        TRACE(context, TRACE_PARSER, "Bison: Created factor with parentheses\n");
     }
     | DEC_CONST {
-        char buffer[100];
-        snprintf(buffer, sizeof(buffer), "%d", $1);
-        $$ = create_node(NODE_NUMBER, NULL, NULL, strdup(buffer));  
-        fprintf(logFile, "Bison: Created factor with DEC_CONST\n");
+        $$ = new_node(context, @$, NODE_NUMBER, NULL, NULL, NULL);
+        $$->number = $1;  // stays an integer through every later pass
+        TRACE(context, TRACE_PARSER, "Bison: Created factor with DEC_CONST\n");
     }
     | ID {
-        $$ = create_node(NODE_ID, NULL, NULL, strdup($1));  
-        fprintf(logFile, "Bison: Created factor with ID\n");
+        $$ = new_node(context, @$, NODE_ID, NULL, NULL, $1);  
+        TRACE(context, TRACE_PARSER, "Bison: Created factor with ID\n");
     }
     ;
 
 %%
 
-void expand_node(TreeNode *node) {
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, void *scanner, compiler_context *context) {
+    if (context->options.statsFormat == STATS_OFF) return scan_token(yylval, yylloc, scanner);
+
+    long long started = stats_clock();
+    int token = scan_token(yylval, yylloc, scanner);
+    stats_add_time(&context->stats, PHASE_LEX, started);
+    if (token != 0) context->stats.counters[COUNTER_TOKENS]++;
+    return token;
+}
+
+TreeNode *new_node(compiler_context *context, int line, NodeType type, TreeNode *left, TreeNode *right, const char *value) {
+    context->stats.counters[COUNTER_NODES]++;
+    TreeNode *node = create_node(&context->astArena, type, left, right, value);
+    node->line = line;
+    return node;
+}
+
+void expand_node(compiler_context *context, TreeNode *node) {
     if (node == NULL) return;  // if node is null, return
 
-    switch (node->type) {  // switch based on node type
-        case NODE_PROGRAM: {
-            expand_node(node->left);
-            break;
-        }
-        case NODE_ASSIGNMENT: {  // handle assignment node
-            symbol *symbol = find_symbol(node->left->value, symbolList);
-            if (symbol == NULL) {
-                symbol = create_symbol(node->left->value);  // create new symbol if not found
-                add_symbol(symbol, &symbolList);  // add it to the symbol list
-            }
-            symbol->value = decide_expression(node->right, symbolList);  // update symbol value
-            fprintf(logFile, "(%s -> %d)\n", symbol->name, symbol->value);  // log symbol and its value
-            break;
-        }
-        case NODE_IF: {  // handle if node
-            int conditionIsTrue = decide_expression(node->left, symbolList);  // evaluate condition
-            if (conditionIsTrue) {
-                expand_node(node->right);  // expand right child if condition is true
-            } else if (node->right && node->right->type == NODE_ELSE) {
-                expand_node(node->right->right);  // expand else branch if condition is false
-            }
-            break;
-        }
-        case NODE_REPEAT: {  // handle repeat node
-            do {
-                expand_node(node->left);  // expand the loop body
-            } while (!decide_expression(node->right, symbolList));  // repeat until condition becomes true
-            break;
-        }
-        case NODE_READ: {  // handle read node
-            symbol *symbol = find_symbol(node->value, symbolList);
-            if (symbol == NULL) {
-                symbol = create_symbol(node->value);  // create new symbol if not found
-                add_symbol(symbol, &symbolList);  // add it to the symbol list
-            }
-            break;
+    bytecode_program program;
+    compile_program(&program, node);  // lower the tree to slot-indexed bytecode
+    context->stats.counters[COUNTER_INTERPRETER_STEPS] += run_program(&program, &context->symbolTable, context->logFile, context->outputFile, record_write, context);  // execute it, logging every assignment
+    free_program(&program);
+}
+
+void record_write(void *user, int value) {
+    compiler_context *context = (compiler_context *)user;
+    if (context->writtenCount == context->writtenCapacity) {  // grow the list of printed values
+        context->writtenCapacity = context->writtenCapacity ? context->writtenCapacity * 2 : 16;
+        context->writtenValues = (int *)realloc(context->writtenValues, context->writtenCapacity * sizeof(int));
+    }
+    context->writtenValues[context->writtenCount++] = value;
+}
+
+void simulate_program(compiler_context *context, const mix_image *image) {
+    mix_machine *machine = (mix_machine *)malloc(sizeof(mix_machine));
+    mix_init(machine);  // empty memory, zero registers
+
+    if (context->options.simulationInput != NULL) {
+        machine->input = fopen(context->options.simulationInput, "r");  // records for the read statements
+        if (machine->input == NULL) {
+            fprintf(stderr, "Error opening simulator input %s!\n", context->options.simulationInput);
         }
-        case NODE_WRITE: {  // handle write node
-            symbol *symbol = find_symbol(node->value, symbolList);  // find symbol by name
-            if (symbol != NULL) {
-                printf("%d", symbol->value);  // print symbol value
-            } else {
-                printf("Semantic Error: variable %s not found", node->value);
-            }
-            break;
+    }
+
+    memcpy(machine->memory, image->memory, sizeof(machine->memory));  // loaded as the built-in assembler left it
+    mix_run(machine, image->start);  // run it until HLT
+    mix_print_report(context->logFile, machine);  // output, time units, instructions, memory
+
+    if (context->options.profile && machine->error[0] == '\0') {
+        line_map map;
+        if (read_line_map(context->mapPath, &map) == 0) {
+            print_line_profile(context->logFile, &map, machine);  // the block counters the program left in memory
         }
-        case NODE_SEQ: {  // handle sequence of statements node
-            expand_node(node->left);  // expand left child
-            expand_node(node->right);  // expand right child
-            break;
+        free_line_map(&map);
+    }
+
+    if (machine->error[0] == '\0' && context->options.simulationInput == NULL) {  // without input both sides read zeros
+        int *values = (int *)malloc((context->writtenCount + 1) * sizeof(int));
+        int count = mix_output_values(machine, values, context->writtenCount + 1);
+        int matches = count == context->writtenCount;
+        for (int i = 0; matches && i < count; i++) {
+            matches = values[i] == context->writtenValues[i];
         }
-        default:  // default case, handle unrecognized node type
-            break;
+        fprintf(context->logFile, "Check: output %s expand_node\n", matches ? "matches" : "differs from");
+        free(values);
     }
-}
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Error: %s\n", s);  // print parsing error message to standard error
+    if (machine->input != NULL) fclose(machine->input);
+    mix_free(machine);
+    free(machine);
 }
 
-void createLogFile() {
-    logFile = fopen("log.txt", "w");  // open log file for writing
-    if (logFile == NULL) {
-        fprintf(stderr, "Error opening log file!\n");  // print error message if file cannot be opened
+void yyerror(YYLTYPE *yylloc, void *scanner, compiler_context *context, const char *s) {
+    (void)scanner;
+    context->failed = 1;
+    if (context->inputPath != NULL) {
+        fprintf(stderr, "%s:%d: Error: %s\n", context->inputPath, *yylloc, s);  // name the file when compiling several
     } else {
-        fprintf(logFile, "LEX/BISON LOGS\n--------------\n");  // initialize log file with a header
+        fprintf(stderr, "Error: %s on line %d\n", s, *yylloc);  // print parsing error message to standard error
     }
 }
 
-int main() {
-    createLogFile();  // create log file
+int createLogFile(compiler_context *context) {
+    context->logFile = fopen(context->logPath, "w");  // open log file for writing
+    if (context->logFile == NULL) {
+        fprintf(stderr, "Error opening log file %s!\n", context->logPath);  // print error message if file cannot be opened
+        return -1;
+    }
+    fprintf(context->logFile, "LEX/BISON LOGS\n--------------\n");  // initialize log file with a header
+    return 0;
+}
 
-    yyparse();  // parse input
+int compile_unit(compiler_context *context) {
+    compile_stats *stats = &context->stats;
+    long long started = stats_clock();
+    source_text text;  // mapped when it is a regular file; the scanner works on it in place
+    int loaded = context->inputPath != NULL ? load_source_file(context->inputPath, &text) : load_source_stream(stdin, &text);
+    if (loaded != 0) {
+        fprintf(stderr, "Error opening source file %s!\n", context->inputPath != NULL ? context->inputPath : "<stdin>");
+        free_source_text(&text);
+        return -1;
+    }
+    long long loadTime = stats_clock() - started;  // counted as scanning
+
+    const char *cacheDirectory = context->options.cacheDirectory;
+    cache_blob source = {text.data, text.length};  // a view of the text, not a copy
+    cache_blob key = {NULL, 0};
+    cache_blob output = {NULL, 0};
+    if (cacheDirectory != NULL) {
+        started = stats_clock();
+        cache_key(&context->options, &source, &key);  // the whole text is part of the key
+
+        cache_entry entry;
+        int hit = cache_lookup(cacheDirectory, &key, &entry);
+        stats_add_time(stats, PHASE_CACHE, started);
+        if (hit) {
+            stats->counters[COUNTER_CACHE_HITS]++;
+            int result = replay_cached(context, &entry);  // no parsing, interpretation or code generation
+            if (result == 0) report_stats(context);
+            cache_entry_free(&entry);
+            free_source_text(&text);
+            free(key.data);
+            return result;
+        }
+        stats->counters[COUNTER_CACHE_MISSES]++;
+    }
 
-    print_tree(logFile, root, 0);  // print syntax tree to log file
+    if (createLogFile(context) != 0) {  // create log file
+        free_source_text(&text);
+        free(key.data);
+        return -1;
+    }
+    if (cacheDirectory != NULL) {
+        context->outputFile = open_memstream(&output.data, &output.length);  // kept for the cache entry
+    } else {
+        context->outputFile = context->outputPath != NULL ? fopen(context->outputPath, "w") : stdout;
+    }
+    if (context->outputFile == NULL) {
+        fprintf(stderr, "Error opening output file %s!\n", context->outputPath);
+        free_source_text(&text);
+        free(key.data);
+        return -1;
+    }
 
-    fprintf(logFile, "\nASSIGNMENTS\n-----------\n");  // help message
+    started = stats_clock();
+
+    void *scanner;
+    yylex_init_extra(context, &scanner);  // the scanner reaches the log and the name pool through the context
+    yy_scan_buffer(text.data, text.length + SOURCE_PADDING, scanner);  // no copy: identifiers are interned straight from the text
+    yyparse(scanner, context);  // parse input
+    yylex_destroy(scanner);
+    free_source_text(&text);  // the tree holds interned names and integers only
+    stats_add_time(stats, PHASE_PARSE, started);
+    stats->phaseNanoseconds[PHASE_PARSE] -= stats->phaseNanoseconds[PHASE_LEX];  // scanner time was measured inside
+    stats->phaseNanoseconds[PHASE_LEX] += loadTime;
+
+    started = stats_clock();
+    print_tree(context->logFile, context->root, 0);  // print syntax tree to log file
+    stats_add_time(stats, PHASE_PRINT_TREE, started);
+
+    fprintf(context->logFile, "\nASSIGNMENTS\n-----------\n");  // help message
+
+    started = stats_clock();
+    expand_node(context, context->root);  // evaluate and execute program
+    stats_add_time(stats, PHASE_INTERPRET, started);
+
+    started = stats_clock();
+    fold_stats foldStats;
+    fold_constants(context->root, &foldStats);  // fold and propagate constants before generating code
+    control_flow_graph cfg;
+    build_cfg(&cfg, context->root);  // basic blocks of the folded program
+    peval_stats pevalStats;
+    if (context->options.partialEvalSteps > 0) {
+        partial_evaluate(&cfg, &context->astArena, context->options.partialEvalSteps, &pevalStats);  // run what needs no input now
+    }
+    dead_code_stats deadCodeStats;
+    eliminate_dead_code(&cfg, &deadCodeStats);  // drop stores nobody reads and blocks nobody reaches
+    loop_plan loopPlan;
+    optimize_loops(&cfg, &context->astArena, &context->names, &loopPlan);  // hoist invariants, pick index-register loop variables
+    value_number_stats valueNumberStats;
+    number_values(&cfg, &context->astArena, &context->names, &valueNumberStats);  // compute repeated expressions of a block once
+    stats_add_time(stats, PHASE_FOLD, started);
+
+    started = stats_clock();
+    storage_plan storage;
+    plan_storage(&storage, &cfg, &context->symbolTable);  // live ranges and packed words of the remaining blocks
+    stats_add_time(stats, PHASE_CODEGEN, started);
+
+    print_symbols(context->logFile, &context->symbolTable);  // print symbol table to log file
+    print_fold_stats(context->logFile, &foldStats);  // report what the optimizer changed
+    if (context->options.partialEvalSteps > 0) print_peval_stats(context->logFile, &cfg, &pevalStats);
+    print_dead_code_stats(context->logFile, &deadCodeStats);
+    print_loop_stats(context->logFile, &loopPlan);
+    print_value_number_stats(context->logFile, &valueNumberStats);
+
+    started = stats_clock();
+    peephole_stats peepholeStats;
+    mix_image *image = NULL;  // assembled in memory for the simulator and for the image or deck
+    if (context->options.simulate || context->imagePath != NULL) image = (mix_image *)malloc(sizeof(mix_image));
+    if (generate_mix_code(&cfg, &context->symbolTable, &storage, &loopPlan, writes_listing(&context->options) ? context->mixalPath : NULL,
+                          context->mapPath, context->options.profile, image, &peepholeStats) != 0) {  // generate code and its line map from the blocks
+        context->failed = 1;  // does not fit in MIX memory
+        if (context->imagePath != NULL) remove(context->imagePath);
+    } else if (context->options.emitFormat == EMIT_IMAGE) {
+        if (write_image_file(image, context->imagePath) != 0) context->failed = 1;
+    } else if (context->options.emitFormat == EMIT_DECK) {
+        if (write_card_deck(image, context->imagePath) != 0) context->failed = 1;
+    }
+    stats_add_time(stats, PHASE_CODEGEN, started);
+    print_peephole_stats(context->logFile, &peepholeStats);  // report what each peephole rule removed
+    print_storage_report(context->logFile, &storage);  // where the program sits in MIX memory
+    if (context->options.printCfg) print_cfg(context->logFile, &cfg);  // blocks and live variables after dead code elimination
+    stats->counters[COUNTER_INSTRUCTIONS_EMITTED] = peepholeStats.instructionsBefore;
+    stats->counters[COUNTER_INSTRUCTIONS_WRITTEN] = peepholeStats.instructionsAfter;
+    stats->counters[COUNTER_MEMORY_WORDS] = storage_data_words(&storage) + storage.codeWords + storage.literalWords + storage.counterWords;
+    free_storage_plan(&storage);
+    free_loop_plan(&loopPlan);
+    free_cfg(&cfg);
+
+    if (context->options.simulate && context->root != NULL && !context->failed) {
+        started = stats_clock();
+        simulate_program(context, image);  // measure the generated code
+        stats_add_time(stats, PHASE_SIMULATE, started);
+    }
+    free(image);
+
+    if (cacheDirectory != NULL) {
+        started = stats_clock();
+        store_cached(context, &key, &output);  // before the statistics, which differ on every run
+        stats_add_time(stats, PHASE_CACHE, started);
+        free(output.data);
+        free(key.data);
+    }
 
-    expand_node(root);  // evaluate and execute program
+    stats->counters[COUNTER_SYMBOL_LOOKUPS] = context->symbolTable.lookups;
+    stats->counters[COUNTER_ARENA_BYTES] = (long long)context->astArena.bytesAllocated;
+    report_stats(context);
 
-    print_symbols(logFile, symbolList);  // print symbol table to log file
+    return context->failed ? -1 : 0;
+}
 
-    generate_mix_code(root);  // generate mixal code from the ast
+int main(int argc, char **argv) {
+    compiler_options options;  // settings shared by every compilation
+    init_compiler_options(&options);
+    int jobs = 0;  // worker threads for several files, 0 picks one per core
+    const char **paths = (const char **)malloc(argc * sizeof(const char *));  // source files given on the command line
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++) {  // parse command line options
+        if (strcmp(argv[i], "--simulate") == 0) {
+            options.simulate = 1;
+        } else if (strncmp(argv[i], "--simulate-input=", 17) == 0) {
+            options.simulate = 1;
+            options.simulationInput = argv[i] + 17;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0 && atoi(argv[i] + 7) > 0) {
+            jobs = atoi(argv[i] + 7);
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            options.statsFormat = STATS_TEXT;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            options.statsFormat = STATS_JSON;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8] >= '0' && argv[i][8] <= '2' && argv[i][9] == '\0') {
+            options.traceLevel = argv[i][8] - '0';
+        } else if (strcmp(argv[i], "--peval") == 0) {
+            options.partialEvalSteps = PEVAL_DEFAULT_STEPS;
+        } else if (strncmp(argv[i], "--peval=", 8) == 0 && atoll(argv[i] + 8) > 0) {
+            options.partialEvalSteps = atoll(argv[i] + 8);
+        } else if (strcmp(argv[i], "--cfg") == 0) {
+            options.printCfg = 1;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options.profile = 1;
+        } else if (strcmp(argv[i], "--emit=mixal") == 0) {
+            options.emitFormat = EMIT_MIXAL;
+        } else if (strcmp(argv[i], "--emit=image") == 0) {
+            options.emitFormat = EMIT_IMAGE;
+        } else if (strcmp(argv[i], "--emit=deck") == 0) {
+            options.emitFormat = EMIT_DECK;
+        } else if (strcmp(argv[i], "--listing") == 0) {
+            options.listing = 1;
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0 && argv[i][12] != '\0') {
+            options.cacheDirectory = argv[i] + 12;
+        } else if (strncmp(argv[i], "--cache-size=", 13) == 0 && atoi(argv[i] + 13) > 0) {
+            options.cacheMaxBytes = atoi(argv[i] + 13) * 1024LL * 1024;  // megabytes
+        } else if (argv[i][0] != '-') {
+            paths[pathCount++] = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--simulate] [--simulate-input=FILE] [--stats[=text|json]] [--trace=0|1|2] [--cfg] [--peval[=STEPS]] [--profile] [--emit=mixal|image|deck] [--listing] [--cache-dir=DIR] [--cache-size=MB] < program\n", argv[0]);
+            fprintf(stderr, "       %s [--jobs=N] [options] file... (writes file.log, file.mixal or file.img or file.deck, file.map and file.out)\n", argv[0]);
+            free(paths);
+            return 1;
+        }
+    }
+
+    if (pathCount > 0) {
+        if (jobs == 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int failures = compile_batch(paths, pathCount, jobs, &options);  // every file in its own context
+        free(paths);
+        return failures > 0 ? 1 : 0;
+    }
+    free(paths);
 
-    fclose(logFile);  // close log file
+    compiler_context context;
+    init_compiler_context(&context, NULL, &options);  // stdin, log.txt and mix.mixal
+
+    compile_unit(&context);
+
+    free_compiler_context(&context);  // closes the log file
 
     return 0;  // exit program
-}
\ No newline at end of file
+}
@@ -1,39 +1,216 @@
 #include "symbol_table.h"
 
-// global variable to track the next available memory location
-int nextMemoryLocation = 2500; // initialize to a starting address
+#define INITIAL_TABLE_CAPACITY 64  // starting slot count for both hash tables (power of two)
 
-void add_symbol(symbol *sym, symbol **symbolList) {
-    sym->next = *symbolList;  // link new symbol to current head
-    *symbolList = sym;  // update head to new symbol
+#define FIRST_MEMORY_LOCATION 2500  // address of the first variable
+
+static uint32_t hash_text(const char *text, size_t length) {
+    uint32_t hash = 2166136261u;  // FNV-1a offset basis
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;  // FNV-1a prime
+    }
+    return hash;
 }
 
-symbol *find_symbol(const char *name, symbol *symbolList) {
-    symbol *current = symbolList;  // start with the head of the list
-    while (current != NULL) {  // traverse the list
-        if (strcmp(current->name, name) == 0) {  // check for a match
-            return current;  // return the found symbol
+static uint32_t hash_pointer(const char *name) {
+    uint64_t key = (uint64_t)(uintptr_t)name;
+    key ^= key >> 33;  // mix the high bits down, names are allocated close together
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static void grow_name_pool(name_pool *pool) {
+    int newCapacity = pool->capacity ? pool->capacity * 2 : INITIAL_TABLE_CAPACITY;
+    const char **newNames = (const char **)calloc(newCapacity, sizeof(const char *));
+    uint32_t *newHashes = (uint32_t *)calloc(newCapacity, sizeof(uint32_t));
+
+    for (int i = 0; i < pool->capacity; i++) {  // rehash every stored name
+        if (pool->names[i] == NULL) continue;
+        int slot = pool->hashes[i] & (newCapacity - 1);
+        while (newNames[slot] != NULL) slot = (slot + 1) & (newCapacity - 1);
+        newNames[slot] = pool->names[i];
+        newHashes[slot] = pool->hashes[i];
+    }
+
+    free(pool->names);
+    free(pool->hashes);
+    pool->names = newNames;
+    pool->hashes = newHashes;
+    pool->capacity = newCapacity;
+}
+
+void init_name_pool(name_pool *pool, arena *storage) {
+    pool->names = NULL;
+    pool->hashes = NULL;
+    pool->capacity = 0;
+    pool->count = 0;
+    pool->storage = storage;
+}
+
+const char *intern_name(name_pool *pool, const char *text, size_t length) {
+    if (pool->count * 2 >= pool->capacity) grow_name_pool(pool);  // keep load factor below 1/2
+
+    uint32_t hash = hash_text(text, length);
+    int slot = hash & (pool->capacity - 1);
+    while (pool->names[slot] != NULL) {  // linear probing
+        const char *name = pool->names[slot];
+        if (pool->hashes[slot] == hash && strncmp(name, text, length) == 0 && name[length] == '\0') {
+            return name;  // already interned
         }
-        current = current->next;  // move to the next symbol
+        slot = (slot + 1) & (pool->capacity - 1);
+    }
+
+    const char *copy = arena_strndup(pool->storage, text, length);  // first occurrence, keep one copy
+    pool->names[slot] = copy;
+    pool->hashes[slot] = hash;
+    pool->count++;
+    return copy;
+}
+
+void free_name_pool(name_pool *pool) {
+    free(pool->names);
+    free(pool->hashes);
+    init_name_pool(pool, NULL);
+}
+
+void init_symbol_table(symbol_table *table) {
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->head = NULL;
+    table->nextMemoryLocation = FIRST_MEMORY_LOCATION;
+    table->lookups = 0;
+}
+
+static void grow_symbol_table(symbol_table *table) {
+    int newCapacity = table->capacity ? table->capacity * 2 : INITIAL_TABLE_CAPACITY;
+    symbol **newSlots = (symbol **)calloc(newCapacity, sizeof(symbol *));
+
+    for (int i = 0; i < table->capacity; i++) {  // rehash every stored symbol
+        if (table->slots[i] == NULL) continue;
+        int slot = hash_pointer(table->slots[i]->name) & (newCapacity - 1);
+        while (newSlots[slot] != NULL) slot = (slot + 1) & (newCapacity - 1);
+        newSlots[slot] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = newSlots;
+    table->capacity = newCapacity;
+}
+
+void add_symbol(symbol *sym, symbol_table *table) {
+    if (table->count * 2 >= table->capacity) grow_symbol_table(table);  // keep load factor below 1/2
+
+    int slot = hash_pointer(sym->name) & (table->capacity - 1);
+    while (table->slots[slot] != NULL) slot = (slot + 1) & (table->capacity - 1);
+    table->slots[slot] = sym;
+    table->count++;
+
+    sym->next = table->head;  // link new symbol to current head
+    table->head = sym;  // update head to new symbol
+}
+
+symbol *find_symbol(const char *name, symbol_table *table) {
+    table->lookups++;
+    if (table->count == 0 || name == NULL) return NULL;  // nothing to search
+
+    int slot = hash_pointer(name) & (table->capacity - 1);
+    while (table->slots[slot] != NULL) {  // probe until an empty slot
+        if (table->slots[slot]->name == name) {  // interned names match by pointer
+            return table->slots[slot];  // return the found symbol
+        }
+        slot = (slot + 1) & (table->capacity - 1);
     }
     return NULL;  // symbol not found
 }
 
-symbol *create_symbol(const char *name) {
+symbol *create_symbol(symbol_table *table, const char *name) {
     symbol *sym = (symbol *)malloc(sizeof(symbol));  // allocate memory for new symbol
-    sym->name = strdup(name);  // copy symbol name
+    sym->name = name;  // names are interned, no copy needed
     sym->value = 0;  // initialize value to 0
-    sym->memoryLocation = nextMemoryLocation;  // assign current memory location
-    nextMemoryLocation += 10;  // move to the next available memory location (adjust step as needed)
+    sym->memoryLocation = table->nextMemoryLocation;  // provisional, plan_storage assigns the final word
+    table->nextMemoryLocation++;  // move to the next available memory location
     sym->next = NULL;  // no next symbol yet
     return sym;  // return the newly created symbol
 }
 
-void print_symbols(FILE *logFile, symbol *symbolList) {
-    symbol *current = symbolList;  // start with the head of the list
+void print_symbols(FILE *logFile, symbol_table *table) {
+    symbol *current = table->head;  // start with the head of the list
     fprintf(logFile, "\nSYMBOL LIST\n-----------\n");  // print header
     while (current != NULL) {  // traverse the list
         fprintf(logFile, "%s: %d (Location: %d)\n", current->name, current->value, current->memoryLocation);  // print symbol details
         current = current->next;  // move to the next symbol
     }
-}
\ No newline at end of file
+}
+
+void free_symbol_table(symbol_table *table) {
+    symbol *current = table->head;
+    while (current != NULL) {  // symbols do not own their names
+        symbol *next = current->next;
+        free(current);
+        current = next;
+    }
+    free(table->slots);
+    init_symbol_table(table);
+}
+
+void init_name_map(name_map *map) {
+    map->names = NULL;
+    map->count = 0;
+    map->capacity = 0;
+    map->slots = NULL;
+    map->slotCapacity = 0;
+}
+
+static void grow_name_map(name_map *map) {
+    int newCapacity = map->slotCapacity ? map->slotCapacity * 2 : INITIAL_TABLE_CAPACITY;
+    int *newSlots = (int *)malloc(newCapacity * sizeof(int));
+    for (int i = 0; i < newCapacity; i++) newSlots[i] = -1;
+
+    for (int i = 0; i < map->count; i++) {  // reinsert every name
+        int slot = hash_pointer(map->names[i]) & (newCapacity - 1);
+        while (newSlots[slot] >= 0) slot = (slot + 1) & (newCapacity - 1);
+        newSlots[slot] = i;
+    }
+
+    free(map->slots);
+    map->slots = newSlots;
+    map->slotCapacity = newCapacity;
+}
+
+int name_map_index(name_map *map, const char *name) {
+    if (map->count * 2 >= map->slotCapacity) grow_name_map(map);  // keep load factor below 1/2
+
+    int slot = hash_pointer(name) & (map->slotCapacity - 1);
+    while (map->slots[slot] >= 0) {
+        if (map->names[map->slots[slot]] == name) return map->slots[slot];  // interned names match by pointer
+        slot = (slot + 1) & (map->slotCapacity - 1);
+    }
+
+    if (map->count == map->capacity) {
+        map->capacity = map->capacity ? map->capacity * 2 : INITIAL_TABLE_CAPACITY;
+        map->names = (const char **)realloc(map->names, map->capacity * sizeof(const char *));
+    }
+    map->names[map->count] = name;
+    map->slots[slot] = map->count;
+    return map->count++;
+}
+
+int name_map_find(const name_map *map, const char *name) {
+    if (map->slotCapacity == 0) return -1;
+
+    int slot = hash_pointer(name) & (map->slotCapacity - 1);
+    while (map->slots[slot] >= 0) {
+        if (map->names[map->slots[slot]] == name) return map->slots[slot];
+        slot = (slot + 1) & (map->slotCapacity - 1);
+    }
+    return -1;
+}
+
+void free_name_map(name_map *map) {
+    free(map->names);
+    free(map->slots);
+    init_name_map(map);
+}
@@ -4,19 +4,54 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#include "../arena/arena.h"
 
 typedef struct symbol_tag {
-    char *name;          // symbol name
+    const char *name;   // interned symbol name (compare by pointer)
     int value;          // symbol value
     int memoryLocation; // symbol memory location
-    struct symbol_tag *next;  // pointer to next symbol in list
+    struct symbol_tag *next;  // pointer to next symbol in list (keeps print order stable)
 } symbol;
 
-extern int nextMemoryLocation; // Global variable for memory location indexing
+typedef struct symbol_table_tag {
+    symbol **slots;     // open-addressing slots, keyed by interned name pointer
+    int capacity;       // number of slots (always a power of two)
+    int count;          // number of symbols stored
+    symbol *head;       // head of the symbol list (most recently added first)
+    int nextMemoryLocation;  // address handed to the next symbol created for this table
+    long long lookups;       // find_symbol calls, for the statistics report
+} symbol_table;
+
+typedef struct name_pool_tag {
+    const char **names;  // open-addressing slots holding the unique strings
+    uint32_t *hashes;    // cached string hash of each slot
+    int capacity;        // number of slots (always a power of two)
+    int count;           // number of names stored
+    arena *storage;      // arena holding the name strings
+} name_pool;
+
+typedef struct name_map_tag {
+    const char **names;  // dense index -> interned name
+    int count;           // number of names mapped
+    int capacity;        // allocated size of names
+    int *slots;          // open-addressing table of dense indexes (-1 marks an empty slot)
+    int slotCapacity;    // number of slots (always a power of two)
+} name_map;
 
-void add_symbol(symbol *sym, symbol **symbolList);  // add a symbol to the list
-symbol *find_symbol(const char *name, symbol *symbolList);  // find a symbol by name
-symbol *create_symbol(const char *name);  // create a new symbol
-void print_symbols(FILE *logFile, symbol *symbolList);  // print all symbols to log file
+void init_name_pool(name_pool *pool, arena *storage);  // intern names into the given arena
+const char *intern_name(name_pool *pool, const char *text, size_t length);  // return the unique copy of a name
+void free_name_pool(name_pool *pool);  // drop the pool index (the names live in the arena)
+void init_symbol_table(symbol_table *table);  // prepare an empty symbol table
+void add_symbol(symbol *sym, symbol_table *table);  // add a symbol to the table
+symbol *find_symbol(const char *name, symbol_table *table);  // find a symbol by interned name
+symbol *create_symbol(symbol_table *table, const char *name);  // create a new symbol at the table's next free location
+void print_symbols(FILE *logFile, symbol_table *table);  // print all symbols to log file
+void free_symbol_table(symbol_table *table);  // release all symbols and the slot array
+void init_name_map(name_map *map);  // prepare an empty name map
+int name_map_index(name_map *map, const char *name);  // dense index of an interned name, assigned on first use
+int name_map_find(const name_map *map, const char *name);  // dense index of a mapped name, -1 when it was never added
+void free_name_map(name_map *map);  // release the name map
 
-#endif
\ No newline at end of file
+#endif
@@ -1,120 +1,196 @@
 #include "syntax_tree.h"
 
-TreeNode* create_node(NodeType type, TreeNode *left, TreeNode *right, char* value) {
-    TreeNode *newNode = (TreeNode *)malloc(sizeof(TreeNode));  // allocate memory for a new node
+TreeNode* create_node(arena *nodes, NodeType type, TreeNode *left, TreeNode *right, const char* value) {
+    TreeNode *newNode = (TreeNode *)arena_alloc(nodes, sizeof(TreeNode));  // bump-allocate the node next to its siblings
     newNode->type = type;  // use enum for node type
     newNode->left = left;  // set left child
     newNode->right = right;  // set right child
-    newNode->value = value ? strdup(value) : NULL;  // copy value string or set to NULL
+    newNode->items = NULL;  // only sequences hold statements
+    newNode->count = 0;
+    newNode->value = value;  // interned value string or NULL, shared rather than copied
+    newNode->line = 0;  // set by the parser for nodes that come from the source
     return newNode;  // return the newly created node
 }
 
-int decide_expression(TreeNode *node, symbol *symbolList) {
+TreeNode* create_sequence(arena *nodes, TreeNode *first) {
+    TreeNode *sequence = create_node(nodes, NODE_SEQ, NULL, NULL, NULL);
+    sequence->items = (TreeNode **)arena_alloc(nodes, sizeof(TreeNode *));
+    sequence->items[0] = first;
+    sequence->count = 1;
+    return sequence;
+}
+
+void append_statement(arena *nodes, TreeNode *sequence, TreeNode *statement) {
+    if ((sequence->count & (sequence->count - 1)) == 0) {  // capacity is the count rounded up to a power of two, so it is full
+        TreeNode **items = (TreeNode **)arena_alloc(nodes, 2 * sequence->count * sizeof(TreeNode *));
+        memcpy(items, sequence->items, sequence->count * sizeof(TreeNode *));  // the old array stays in the arena, at most doubling the space
+        sequence->items = items;
+    }
+    sequence->items[sequence->count++] = statement;
+}
+
+void work_stack_init(work_stack *stack, int frameSize) {
+    stack->frames = NULL;
+    stack->frameSize = frameSize;
+    stack->count = 0;
+    stack->capacity = 0;
+}
+
+void* work_stack_push(work_stack *stack) {
+    if (stack->count == stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 64;
+        stack->frames = (char *)realloc(stack->frames, (size_t)stack->capacity * stack->frameSize);
+    }
+    void *frame = stack->frames + (size_t)stack->count++ * stack->frameSize;
+    memset(frame, 0, stack->frameSize);
+    return frame;
+}
+
+void* work_stack_top(work_stack *stack) {
+    return stack->frames + (size_t)(stack->count - 1) * stack->frameSize;
+}
+
+void work_stack_pop(work_stack *stack) {
+    stack->count--;
+}
+
+void work_stack_free(work_stack *stack) {
+    free(stack->frames);
+    stack->frames = NULL;
+    stack->count = 0;
+    stack->capacity = 0;
+}
+
+int decide_expression(TreeNode *node, symbol_table *symbolTable) {
     if (node == NULL) return 0;  // base case: if node is NULL, return 0
 
     switch (node->type) {
         case NODE_NUMBER:
-            return atoi(node->value);  // convert value to integer
+            return node->number;  // parsed by the scanner
 
         case NODE_ID: {
-            symbol *symbol = find_symbol(node->value, symbolList);  // find symbol by name
+            symbol *symbol = find_symbol(node->value, symbolTable);  // find symbol by name
             return symbol ? symbol->value : 0;  // return symbol value or 0 if not found
         }
 
         case NODE_LT:
-            return decide_expression(node->left, symbolList) < decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) < decide_expression(node->right, symbolTable);
 
         case NODE_EQ:
-            return decide_expression(node->left, symbolList) == decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) == decide_expression(node->right, symbolTable);
 
         case NODE_ADD:
-            return decide_expression(node->left, symbolList) + decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) + decide_expression(node->right, symbolTable);
 
         case NODE_SUBTRACT:
-            return decide_expression(node->left, symbolList) - decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) - decide_expression(node->right, symbolTable);
 
         case NODE_MULTIPLY:
-            return decide_expression(node->left, symbolList) * decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) * decide_expression(node->right, symbolTable);
 
         case NODE_DIVIDE:
-            return decide_expression(node->left, symbolList) / decide_expression(node->right, symbolList);
+            return decide_expression(node->left, symbolTable) / decide_expression(node->right, symbolTable);
 
         default:
             return 0;  // return 0 for unknown node types
     }
 }
 
+typedef struct {
+    TreeNode *node;
+    int level;
+} print_frame;
+
 void print_tree(FILE *logFile, TreeNode *node, int level) {
     if (node == NULL) return;  // base case: if node is NULL, return
 
     if (level == 0) fprintf(logFile, "\nSYNTAX TREE\n-----------\n");  // print header for the tree
 
-    // Indent based on the level of the tree
-    for (int i = 0; i < level; i++) {
-        fprintf(logFile, "  ");  // indent for each level
-    }
+    work_stack stack;  // nodes still to print, the next one on top
+    work_stack_init(&stack, sizeof(print_frame));
+    print_frame *start = (print_frame *)work_stack_push(&stack);
+    start->node = node;
+    start->level = level;
+
+    while (stack.count > 0) {
+        print_frame frame = *(print_frame *)work_stack_top(&stack);
+        work_stack_pop(&stack);
+        node = frame.node;
+
+        fprintf(logFile, "%*s", 2 * frame.level, "");  // indent two spaces for each level
+
+        // Print the node type based on enum
+        switch (node->type) {
+            case NODE_PROGRAM:
+                fprintf(logFile, "PROGRAM");
+                break;
+            case NODE_ASSIGNMENT:
+                fprintf(logFile, "AS (:=)");
+                break;
+            case NODE_IF:
+                fprintf(logFile, "IF");
+                break;
+            case NODE_ELSE:
+                fprintf(logFile, "ELSE");
+                break;
+            case NODE_REPEAT:
+                fprintf(logFile, "REPEAT");
+                break;
+            case NODE_READ:
+                fprintf(logFile, "READ");
+                break;
+            case NODE_WRITE:
+                fprintf(logFile, "WRITE");
+                break;
+            case NODE_SEQ:
+                fprintf(logFile, "SEQ");
+                break;
+            case NODE_LT:
+                fprintf(logFile, "LT (<)");
+                break;
+            case NODE_EQ:
+                fprintf(logFile, "EQ (=)");
+                break;
+            case NODE_ADD:
+                fprintf(logFile, "ADD (+)");
+                break;
+            case NODE_SUBTRACT:
+                fprintf(logFile, "SUB (-)");
+                break;
+            case NODE_MULTIPLY:
+                fprintf(logFile, "MUL (*)");
+                break;
+            case NODE_DIVIDE:
+                fprintf(logFile, "DIV (/)");
+                break;
+            case NODE_NUMBER:
+                fprintf(logFile, "NUMBER");
+                break;
+            case NODE_ID:
+                fprintf(logFile, "ID");
+                break;
+            default:
+                fprintf(logFile, "unknown");
+        }
 
-    // Print the node type based on enum
-    switch (node->type) {
-        case NODE_PROGRAM:
-            fprintf(logFile, "PROGRAM");
-            break;
-        case NODE_ASSIGNMENT:
-            fprintf(logFile, "AS (:=)");
-            break;
-        case NODE_IF:
-            fprintf(logFile, "IF");
-            break;
-        case NODE_ELSE:
-            fprintf(logFile, "ELSE");
-            break;
-        case NODE_REPEAT:
-            fprintf(logFile, "REPEAT");
-            break;
-        case NODE_READ:
-            fprintf(logFile, "READ");
-            break;
-        case NODE_WRITE:
-            fprintf(logFile, "WRITE");
-            break;
-        case NODE_SEQ:
-            fprintf(logFile, "SEQ");
-            break;
-        case NODE_LT:
-            fprintf(logFile, "LT (<)");
-            break;
-        case NODE_EQ:
-            fprintf(logFile, "EQ (=)");
-            break;
-        case NODE_ADD:
-            fprintf(logFile, "ADD (+)");
-            break;
-        case NODE_SUBTRACT:
-            fprintf(logFile, "SUB (-)");
-            break;
-        case NODE_MULTIPLY:
-            fprintf(logFile, "MUL (*)");
-            break;
-        case NODE_DIVIDE:
-            fprintf(logFile, "DIV (/)");
-            break;
-        case NODE_NUMBER:
-            fprintf(logFile, "NUMBER");
-            break;
-        case NODE_ID:
-            fprintf(logFile, "ID");
-            break;
-        default:
-            fprintf(logFile, "unknown");
-    }
+        if (node->type == NODE_NUMBER) {
+            fprintf(logFile, " (%d)", node->number);
+        } else if (node->value) {
+            fprintf(logFile, " (%s)", node->value);  // print node value if available
+        }
 
-    if (node->value) {
-        fprintf(logFile, " (%s)", node->value);  // print node value if available
+        fprintf(logFile, "\n");
+
+        // push the children in reverse so they come off the stack in order
+        TreeNode *children[2] = { node->left, node->right };
+        TreeNode **items = node->type == NODE_SEQ ? node->items : children;
+        int count = node->type == NODE_SEQ ? node->count : 2;
+        for (int i = count - 1; i >= 0; i--) {
+            if (items[i] == NULL) continue;
+            print_frame *child = (print_frame *)work_stack_push(&stack);
+            child->node = items[i];
+            child->level = frame.level + 1;
+        }
     }
-
-    fprintf(logFile, "\n");
-
-    // recursively print left and right subtrees
-    print_tree(logFile, node->left, level + 1);
-    print_tree(logFile, node->right, level + 1);
-}
\ No newline at end of file
+    work_stack_free(&stack);
+}
@@ -3,6 +3,7 @@
 
 #include "node_types.h"
 #include "../symbol_table/symbol_table.h"
+#include "../arena/arena.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,13 +11,33 @@
 
 typedef struct TreeNode {
     NodeType type;          // type of the node (now an enum)
+    union {
+        int count;          // number of statements in items (NODE_SEQ only)
+        int number;         // the constant of a NODE_NUMBER, parsed once by the scanner
+    };
     struct TreeNode *left;  // pointer to the left child
     struct TreeNode *right; // pointer to the right child
-    char* value;            // value of the node (if it's a number or identifier)
+    struct TreeNode **items; // statements of a NODE_SEQ in source order
+    const char* value;      // interned name of an identifier, NULL for numbers
+    int line;               // source line the node starts on, 0 for nodes the compiler made
 } TreeNode;
 
-TreeNode* create_node(NodeType type, TreeNode *left, TreeNode *right, char* value);  // create a new tree node
-int decide_expression(TreeNode *node, symbol *symbolList);  // evaluate the expression represented by the tree
+typedef struct {
+    char *frames;   // frames of frameSize bytes, the top one last
+    int frameSize;
+    int count;
+    int capacity;
+} work_stack;  // explicit stack for passes that walk expressions without recursing
+
+TreeNode* create_node(arena *nodes, NodeType type, TreeNode *left, TreeNode *right, const char* value);  // create a new tree node in the arena (value must be interned)
+TreeNode* create_sequence(arena *nodes, TreeNode *first);  // create a NODE_SEQ holding one statement
+void append_statement(arena *nodes, TreeNode *sequence, TreeNode *statement);  // add a statement to the end of a NODE_SEQ
+void work_stack_init(work_stack *stack, int frameSize);
+void* work_stack_push(work_stack *stack);  // zeroed frame on top; pointers to other frames become invalid
+void* work_stack_top(work_stack *stack);
+void work_stack_pop(work_stack *stack);
+void work_stack_free(work_stack *stack);
+int decide_expression(TreeNode *node, symbol_table *symbolTable);  // evaluate the expression represented by the tree
 void print_tree(FILE *logFile, TreeNode *node, int level);  // print the tree structure to the log file
 
 #endif
\ No newline at end of file
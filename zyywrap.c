@@ -1,5 +1,6 @@
 #include <stdio.h>
 
-int yywrap(void) {
+int yywrap(void *scanner) {  // reentrant scanners pass their state
+    (void)scanner;
     return 1;
 }
\ No newline at end of file